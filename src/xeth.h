@@ -13,6 +13,7 @@
 #define __XETH_UAPI_H
 
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 #ifdef IFNAMSIZE
 # define XETH_IFNAMSIZ IFNAMSIZ
@@ -116,6 +117,21 @@ enum xeth_msg_kind {
 	XETH_MSG_KIND_CHANGE_UPPER_XID,
 	XETH_MSG_KIND_NETNS_ADD,
 	XETH_MSG_KIND_NETNS_DEL,
+	XETH_MSG_KIND_SEQ,
+	XETH_MSG_KIND_RESYNC,
+	XETH_MSG_KIND_SUBSCRIBE,
+	XETH_MSG_KIND_NEXTHOP,
+	XETH_MSG_KIND_NEXTHOP_GROUP,
+	XETH_MSG_KIND_FIBNHENTRY,
+	XETH_MSG_KIND_DUMP_FIBINFO_COMPACT,
+	XETH_MSG_KIND_FIBDUMP,
+	XETH_MSG_KIND_FIBDUMP_NHSET,
+	XETH_MSG_KIND_FIB_FILTER,
+	XETH_MSG_KIND_HELLO,
+	XETH_MSG_KIND_STATS_REQUEST,
+	XETH_MSG_KIND_LINK_STATS,
+	XETH_MSG_KIND_ETHTOOL_STATS,
+	XETH_MSG_KIND_QSFP,
 };
 
 enum xeth_link_stat {
@@ -260,6 +276,76 @@ struct xeth_msg_ethtool_link_modes {
 	uint64_t modes;
 };
 
+/* XETH_MSG_KIND_DUMP_FIBINFO_COMPACT: controller to kernel, as DUMP_FIBINFO
+ * but with the replayed routes sent as FIBDUMP blocks; changes during and
+ * after the dump are sent as usual. The blocks are only sent if the
+ * requester has XETH_CAP_FIBDUMP_COMPACT; otherwise, and by generic
+ * netlink, this is a DUMP_FIBINFO.
+ *
+ * XETH_MSG_KIND_FIBDUMP: @n routes of @table in @net, @len bytes of
+ * records, each:
+ *	u8 prefix length
+ *	u8 bits 0-4: leading address bytes shared with the previous record
+ *	   bit 5: type follows, otherwise RTN_UNICAST
+ *	   bit 6: tos follows, otherwise 0
+ *	the remaining of the (length + 7) / 8 address bytes
+ *	[u8 type] [u8 tos]
+ *	LEB128 index of a FIBDUMP_NHSET
+ * The first record of each message shares nothing.
+ */
+struct xeth_msg_fibdump {
+	struct xeth_msg_header header;
+	uint64_t net;
+	uint32_t table;
+	uint8_t family;
+	uint8_t pad;
+	uint16_t n;
+	uint32_t len;
+	uint32_t reserved;
+	uint8_t data[];
+};
+
+/* XETH_MSG_KIND_FIBDUMP_NHSET: the nexthops of FIBDUMP routes with @index;
+ * either nexthop object @nhid, or @n struct xeth_next_hop (AF_INET) or
+ * struct xeth_next_hop6 (AF_INET6). Indexes are valid until the dump's
+ * BREAK.
+ */
+struct xeth_msg_fibdump_nhset {
+	struct xeth_msg_header header;
+	uint64_t net;
+	uint32_t index;
+	uint32_t nhid;
+	uint8_t family;
+	uint8_t pad;
+	uint16_t n;
+	uint32_t reserved;
+	uint8_t nh[];
+};
+
+/* A zero field matches any net, table or family. */
+struct xeth_fib_filter_entry {
+	uint64_t net;
+	uint32_t table;
+	uint8_t family;
+	uint8_t pad[3];
+};
+
+/* XETH_MSG_KIND_FIB_FILTER: controller to kernel, the allow-list of FIB
+ * entry and nexthop notifications; @n of 0 allows all, the default.
+ *
+ * Each controller has its own filter, the last it sent, dropped with its
+ * session; genl can't set one. Deletions always pass, since the controller
+ * may have the route from before its filter narrowed. A wider filter
+ * doesn't send the routes it now allows; so, set it before DUMP_FIBINFO or
+ * dump again.
+ */
+struct xeth_msg_fib_filter {
+	struct xeth_msg_header header;
+	uint32_t n;
+	uint32_t reserved;
+	struct xeth_fib_filter_entry entries[];
+};
+
 struct xeth_next_hop {
 	int32_t ifindex;
 	int32_t weight;
@@ -303,6 +389,25 @@ struct xeth_msg_fib6entry {
 	struct xeth_next_hop6 siblings[];
 };
 
+/* XETH_MSG_KIND_FIBNHENTRY: an IPv4 or IPv6 route through nexthop object
+ * @nhid; sent instead of FIBENTRY or FIB6ENTRY with the nexthop_objects
+ * module parameter. The referenced NEXTHOP and NEXTHOP_GROUP precede it.
+ * IPv4 @address is in the first 4 bytes.
+ */
+struct xeth_msg_fibnhentry {
+	struct xeth_msg_header header;
+	uint64_t net;
+	uint8_t address[16];
+	uint8_t length;
+	uint8_t event;
+	uint8_t family;
+	uint8_t type;
+	uint32_t table;
+	uint32_t nhid;
+	uint8_t tos;
+	uint8_t pad[3];
+};
+
 struct xeth_msg_ifa {
 	struct xeth_msg_header header;
 	uint32_t xid;
@@ -355,6 +460,95 @@ struct xeth_msg_netns {
 	uint64_t net;
 };
 
+/* XETH_MSG_KIND_NEXTHOP: nexthop object @id, new or changed; or with @id 0,
+ * @event FIB_EVENT_NH_ADD (alive) or FIB_EVENT_NH_DEL (dead) of an inline
+ * IPv4 route nexthop identified by @ifindex and @gw.
+ *
+ * There is no delete of nexthop objects; the kernel deletes the routes that
+ * reference them, so the controller may reclaim an unreferenced @id.
+ */
+struct xeth_msg_nexthop {
+	struct xeth_msg_header header;
+	uint64_t net;
+	uint32_t id;
+	int32_t ifindex;
+	uint32_t flags;
+	uint8_t family;
+	uint8_t event;
+	uint8_t scope;
+	uint8_t reject;
+	uint8_t gw[16];
+};
+
+struct xeth_nexthop_grp_entry {
+	uint32_t id;
+	uint32_t weight;
+};
+
+/* XETH_MSG_KIND_NEXTHOP_GROUP: the members of nexthop object @id, each
+ * sent as NEXTHOP before the group.
+ */
+struct xeth_msg_nexthop_group {
+	struct xeth_msg_header header;
+	uint64_t net;
+	uint32_t id;
+	uint16_t n;
+	uint8_t mpath;
+	uint8_t pad;
+	struct xeth_nexthop_grp_entry nh[];
+};
+
+/* XETH_MSG_KIND_SEQ: kernel to controller
+ *	@seq: the sequence number of the next sequenced message; following
+ *	      messages are implicitly numbered @seq + 1, @seq + 2, ...
+ * XETH_MSG_KIND_RESYNC: controller to kernel at the start of a session
+ *	@seq: the last sequence number before the first that the controller
+ *	      missed in an earlier session, or 0 for a cold start
+ * @epoch: identifies the mux instance that numbered the messages
+ *
+ * The kernel answers RESYNC with SEQ. If the answer is @seq + 1, the
+ * messages missed while disconnected follow; otherwise the replay journal
+ * has overflowed and the controller must request DUMP_IFINFO and
+ * DUMP_FIBINFO.
+ *
+ * Interface, address, ethtool and netns messages are sent ahead of any
+ * route, nexthop and neighbour backlog, with a SEQ before each jump in
+ * numbering. So the received numbers may have gaps that are filled later,
+ * and RESYNC @seq is the low-water mark below the first gap. The replay
+ * may repeat control messages received past that mark. Interface NEW, DEL,
+ * REG and UNREG, and netns ADD and DEL, never pass earlier bulk messages,
+ * which may refer to them; nor does the BREAK that ends a FIB dump.
+ */
+struct xeth_msg_seq {
+	struct xeth_msg_header header;
+	uint64_t seq;
+	uint64_t epoch;
+};
+
+enum xeth_qsfp_event {
+	XETH_QSFP_EVENT_INSERTED,
+	XETH_QSFP_EVENT_REMOVED,
+	XETH_QSFP_EVENT_INTERRUPT,
+};
+
+/* XETH_MSG_KIND_QSFP: kernel to controller
+ *	@xid: port of the module
+ *	@event: XETH_QSFP_EVENT_*
+ *	@flags: with INTERRUPT, the latched flags of lower page bytes 3
+ *		through 21, which the kernel's read has cleared
+ *
+ * The kernel probes inserted modules and drops removed ones by the absent
+ * line interrupt, and reads the flags by the IntL interrupt, of ports
+ * with those GPIOs.
+ */
+struct xeth_msg_qsfp {
+	struct xeth_msg_header header;
+	uint32_t xid;
+	uint32_t event;
+	uint8_t flags[19];
+	uint8_t pad[5];
+};
+
 struct xeth_msg_speed {
 	struct xeth_msg_header header;
 	uint32_t xid;
@@ -368,4 +562,200 @@ struct xeth_msg_stat {
 	uint64_t count;
 };
 
+/* XETH_MSG_KIND_LINK_STATS, XETH_MSG_KIND_ETHTOOL_STATS: controller to kernel
+ *	@xid: interface of the stats
+ *	@first: XETH_LINK_STAT_* or ethtool stat index of @count[0]
+ *	@n: number of @count
+ *	@time: CLOCK_REALTIME ns when the hardware counters were sampled,
+ *		or 0 if unknown
+ *
+ * Readers see all or none of the counts of each message, unlike those of a
+ * LINK_STAT or ETHTOOL_STAT per counter, so rates computed from several
+ * counters are consistent. A port's ethtool stats end with the
+ * "stats_time_ns" and "link_stats_time_ns" of its last messages with a
+ * @time, so rates needn't include side-band queueing delay.
+ */
+struct xeth_msg_stats {
+	struct xeth_msg_header header;
+	uint32_t xid;
+	uint32_t first;
+	uint32_t n;
+	uint32_t reserved;
+	uint64_t time;
+	uint64_t count[];
+};
+
+/* XETH_MSG_KIND_SUBSCRIBE: controller to kernel before RESYNC or a dump
+ *	@kinds: bitmask of (1 << XETH_MSG_KIND_*) to receive, default all
+ *
+ * Each connected controller has its own subscription. A dump is sent to its
+ * requester alone, between the changes sent to all; other controllers only
+ * see a gap in its sequence numbers.
+ */
+struct xeth_msg_subscribe {
+	struct xeth_msg_header header;
+	uint64_t kinds;
+};
+
+enum xeth_cap_bit {
+	XETH_CAP_NEXTHOP_OBJECTS_BIT,
+	XETH_CAP_FIBDUMP_COMPACT_BIT,
+	XETH_CAP_STATS_PULL_BIT,
+	XETH_N_CAPS,
+};
+
+enum xeth_cap {
+	XETH_CAP_NEXTHOP_OBJECTS = 1 << XETH_CAP_NEXTHOP_OBJECTS_BIT,
+	XETH_CAP_FIBDUMP_COMPACT = 1 << XETH_CAP_FIBDUMP_COMPACT_BIT,
+	XETH_CAP_STATS_PULL = 1 << XETH_CAP_STATS_PULL_BIT,
+};
+
+/* XETH_MSG_KIND_HELLO: controller to kernel first, then kernel to controller
+ *	@kinds: bitmask of (1 << XETH_MSG_KIND_*) understood
+ *	@caps: bitmask of XETH_CAP_* supported
+ *
+ * The kernel answers with the kinds it understands and the capabilities
+ * agreed. A controller that doesn't say HELLO understands all kinds and no
+ * capabilities, as before the handshake.
+ *
+ * The header version no longer changes with protocol extensions; new
+ * message kinds and encodings are capabilities instead. Since the kernel
+ * encodes messages once for all controllers, those encodings in effect are
+ * the capabilities shared by every controller that has resync'd or
+ * requested a dump; a controller with fewer capabilities than were in effect
+ * for its missed messages gets a RESYNC answer that requires a dump.
+ */
+struct xeth_msg_hello {
+	struct xeth_msg_header header;
+	uint64_t kinds;
+	uint64_t caps;
+};
+
+enum xeth_stats_request_bit {
+	XETH_STATS_REQUEST_LINK_BIT,
+	XETH_STATS_REQUEST_ETHTOOL_BIT,
+	XETH_N_STATS_REQUESTS,
+};
+
+enum xeth_stats_request {
+	XETH_STATS_REQUEST_LINK = 1 << XETH_STATS_REQUEST_LINK_BIT,
+	XETH_STATS_REQUEST_ETHTOOL = 1 << XETH_STATS_REQUEST_ETHTOOL_BIT,
+};
+
+/* XETH_MSG_KIND_STATS_REQUEST: kernel to controller, then echoed back
+ *	@xid: interface of the stats
+ *	@stats: bitmask of XETH_STATS_REQUEST_*
+ *
+ * With XETH_CAP_STATS_PULL in effect, the controller needn't stream its
+ * stats. Instead, the kernel requests the stats of an interface as they're
+ * read if those it has are older than its stats_age parameter, at most once
+ * per stats_age. The controller answers with the LINK_STATS or
+ * ETHTOOL_STATS messages of @xid then echoes the request to mark the
+ * refresh complete.
+ * Readers get the cached counts while the refresh is outstanding. An
+ * ethtool reader may instead wait up to the stats_wait parameter for the
+ * echo; that's off by default since it holds rtnl meanwhile.
+ */
+struct xeth_msg_stats_request {
+	struct xeth_msg_header header;
+	uint32_t xid;
+	uint32_t stats;
+};
+
+/* Side-band ring transport
+ *
+ * As an alternative to the side-band socket, a controller may open the
+ * character device named like the mux (e.g. /dev/xeth-mux) and mmap
+ * XETH_RING_MMAP_SIZE bytes at offset 0. This maps the kernel to controller
+ * ring, followed by the controller to kernel ring, each a header page and
+ * XETH_RING_DATA_SIZE bytes of records. Each open is a separate client that
+ * carries the same messages as a socket connection.
+ *
+ * A record is a struct xeth_ring_record and its message, padded to 8 bytes.
+ * A record never wraps; a length of XETH_RING_WRAP means the next record is
+ * at the start of the data.
+ *
+ * @head and @tail are free-running byte counts written only by the producer
+ * and consumer, respectively. Each side publishes its count with a store
+ * release after writing or reading the records.
+ *
+ * The device polls readable while the kernel to controller ring isn't
+ * empty, writable while the controller to kernel ring has room, and hangs up
+ * when the kernel drops the client. After producing, the controller rings
+ * the XETH_RING_IOC_KICK doorbell; otherwise, the kernel checks every 10 ms.
+ */
+enum {
+	XETH_RING_HEADER_SIZE = 4096,
+	XETH_RING_DATA_SIZE = 1 << 20,
+	XETH_RING_SIZE = XETH_RING_HEADER_SIZE + XETH_RING_DATA_SIZE,
+	XETH_RING_MMAP_SIZE = 2 * XETH_RING_SIZE,
+	XETH_RING_WRAP = 0xffffffff,
+};
+
+struct xeth_ring_header {
+	uint64_t head;
+	uint8_t pad0[56];
+	uint64_t tail;
+	uint8_t pad1[56];
+	uint32_t size;
+	uint32_t reserved;
+};
+
+struct xeth_ring_record {
+	uint32_t len;
+	uint32_t reserved;
+};
+
+#define XETH_RING_IOC_KICK	_IO('x', 0)
+
+/* Generic netlink side-band
+ *
+ * The kernel also multicasts side-band messages on the "xeth" generic
+ * netlink family, to the group of their kind, as XETH_GENL_CMD_EVENT with
+ * the mux ifindex and message attributes. A BREAK goes to all but the stats
+ * group; the stats group carries STATS_REQUEST and the stats messages
+ * received from the controller. Unlike a side-band client, listeners
+ * aren't sequenced, journaled, or coalesced; each message is multicast as
+ * it's logged, so listeners also get those that a side-band client would
+ * only see superseded by a later one of the same key. A side-band client's
+ * dump isn't multicast, and one requested by XETH_GENL_CMD_MSG is only
+ * multicast, never compact, and not logged for side-band clients.
+ *
+ * XETH_GENL_CMD_MSG sends a controller message (e.g. DUMP_IFINFO or
+ * CARRIER) to the mux of the given ifindex; RESYNC and SUBSCRIBE are only
+ * valid from side-band clients.
+ */
+#define XETH_GENL_NAME		"xeth"
+#define XETH_GENL_VERSION	1
+
+enum xeth_genl_cmd {
+	XETH_GENL_CMD_UNSPEC,
+	XETH_GENL_CMD_EVENT,
+	XETH_GENL_CMD_MSG,
+};
+
+enum xeth_genl_attr {
+	XETH_GENL_A_UNSPEC,
+	XETH_GENL_A_MUX,	/* u32 ifindex */
+	XETH_GENL_A_MSG,	/* struct xeth_msg_* */
+	__XETH_GENL_A_MAX,
+};
+
+#define XETH_GENL_A_MAX	(__XETH_GENL_A_MAX - 1)
+
+enum xeth_genl_mcgrp {
+	XETH_GENL_MCGRP_LINK,
+	XETH_GENL_MCGRP_ADDR,
+	XETH_GENL_MCGRP_FIB,
+	XETH_GENL_MCGRP_NEIGH,
+	XETH_GENL_MCGRP_STATS,
+	XETH_GENL_N_MCGRPS,
+};
+
+#define XETH_GENL_MCGRP_LINK_NAME	"link"
+#define XETH_GENL_MCGRP_ADDR_NAME	"addr"
+#define XETH_GENL_MCGRP_FIB_NAME	"fib"
+#define XETH_GENL_MCGRP_NEIGH_NAME	"neigh"
+#define XETH_GENL_MCGRP_STATS_NAME	"stats"
+
 #endif /* __XETH_UAPI_H */
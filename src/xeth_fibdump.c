@@ -0,0 +1,334 @@
+/**
+ * Compact FIB dump
+ *
+ * During a DUMP_FIBINFO_COMPACT replay, routes are front coded into FIBDUMP
+ * blocks of the same (net, table, family) with their nexthops replaced by
+ * the index of a FIBDUMP_NHSET sent earlier in the dump. The FIB replay
+ * walks each table in key order so most records differ from their
+ * predecessor by one or two address bytes.
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ * Copyright(c) 2018-2020 Platina Systems, Inc.
+ *
+ * Contact Information:
+ * sw@platina.com
+ * Platina Systems, 3180 Del La Cruz Blvd, Santa Clara, CA 95054
+ */
+
+#include "xeth_fibdump.h"
+#include "xeth_mux.h"
+#include "xeth_nh.h"
+#include "xeth_sbtx.h"
+#include "xeth_debug.h"
+#include <linux/jhash.h>
+#include <net/ip_fib.h>
+#include <net/ip6_fib.h>
+#include <net/nexthop.h>
+
+enum {
+	xeth_fibdump_max_len = XETH_SIZEOF_JUMBO_FRAME -
+		sizeof(struct xeth_msg_fibdump),
+	xeth_fibdump_max_nhset = XETH_SIZEOF_JUMBO_FRAME -
+		sizeof(struct xeth_msg_fibdump_nhset),
+	/* length, shared, address, type, tos, and a 5 byte LEB128 index */
+	xeth_fibdump_max_record = 1 + 1 + 16 + 1 + 1 + 5,
+	xeth_fibdump_shared_mask = 0x1f,
+	xeth_fibdump_has_type = 0x20,
+	xeth_fibdump_has_tos = 0x40,
+};
+
+struct xeth_fibdump_set {
+	struct hlist_node node;
+	u64 net;
+	u32 index, nhid;
+	u8 family;
+	u16 n;
+	size_t sz;
+	u8 nh[];
+};
+
+void xeth_fibdump_init(struct xeth_fibdump *xfd)
+{
+	spin_lock_init(&xfd->mutex);
+	hash_init(xfd->ht);
+}
+
+static inline struct xeth_msg_fibdump *
+xeth_fibdump_msg(struct xeth_fibdump *xfd)
+{
+	return xeth_sbtxb_data(xfd->sbtxb);
+}
+
+/* call with xfd lock held */
+static void xeth_fibdump_flush(struct net_device *mux,
+			       struct xeth_fibdump *xfd)
+{
+	struct xeth_msg_fibdump *msg;
+
+	if (!xfd->sbtxb)
+		return;
+	msg = xeth_fibdump_msg(xfd);
+	xfd->sbtxb->len = sizeof(*msg) + msg->len;
+	xeth_mux_queue_sbtx(mux, xfd->sbtxb);
+	xfd->sbtxb = NULL;
+}
+
+/* call with xfd lock held; return 0 if out of memory */
+static u32 xeth_fibdump_set(struct net_device *mux, struct xeth_fibdump *xfd,
+			    u64 net, u8 family, u32 nhid, u16 n, size_t sz)
+{
+	struct xeth_fibdump_set *set;
+	u32 hash;
+
+	hash = jhash(xfd->scratch, sz, jhash_3words(family, nhid, n, net));
+	hash_for_each_possible(xfd->ht, set, node, hash)
+		if (set->net == net && set->family == family &&
+		    set->nhid == nhid && set->n == n && set->sz == sz &&
+		    !memcmp(set->nh, xfd->scratch, sz))
+			return set->index;
+	set = kzalloc(sizeof(*set) + sz, GFP_ATOMIC);
+	if (!set)
+		return 0;
+	set->net = net;
+	set->index = ++xfd->sets;
+	set->nhid = nhid;
+	set->family = family;
+	set->n = n;
+	set->sz = sz;
+	memcpy(set->nh, xfd->scratch, sz);
+	hash_add(xfd->ht, &set->node, hash);
+	if (xeth_sbtx_fibdump_nhset(mux, net, set->index, family, nhid,
+				    set->nh, n, sz)) {
+		hash_del(&set->node);
+		kfree(set);
+		xfd->sets--;
+		return 0;
+	}
+	return set->index;
+}
+
+/* call with xfd lock held; return false if out of memory */
+static bool xeth_fibdump_record(struct net_device *mux,
+				struct xeth_fibdump *xfd,
+				u64 net, u32 table, u8 family,
+				const u8 *addr, u8 length, u8 type, u8 tos,
+				u32 set)
+{
+	struct xeth_msg_fibdump *msg;
+	size_t alen = (length + 7) / 8;
+	u8 shared = 0, *p;
+
+	if (xfd->sbtxb) {
+		msg = xeth_fibdump_msg(xfd);
+		if (xfd->net != net || xfd->table != table ||
+		    xfd->family != family ||
+		    msg->len + xeth_fibdump_max_record > xeth_fibdump_max_len)
+			xeth_fibdump_flush(mux, xfd);
+	}
+	if (!xfd->sbtxb) {
+		xfd->sbtxb = xeth_mux_alloc_sbtxb(mux, XETH_SIZEOF_JUMBO_FRAME);
+		if (!xfd->sbtxb)
+			return false;
+		msg = xeth_fibdump_msg(xfd);
+		xeth_msg_init(msg, XETH_MSG_KIND_FIBDUMP);
+		msg->net = xfd->net = net;
+		msg->table = xfd->table = table;
+		msg->family = xfd->family = family;
+	} else
+		while (shared < alen && xfd->prev[shared] == addr[shared])
+			shared++;
+	msg = xeth_fibdump_msg(xfd);
+	p = &msg->data[msg->len];
+	*p++ = length;
+	*p++ = shared |
+		(type != RTN_UNICAST ? xeth_fibdump_has_type : 0) |
+		(tos ? xeth_fibdump_has_tos : 0);
+	memcpy(p, addr + shared, alen - shared);
+	p += alen - shared;
+	if (type != RTN_UNICAST)
+		*p++ = type;
+	if (tos)
+		*p++ = tos;
+	for (; set >= 0x80; set >>= 7)
+		*p++ = (set & 0x7f) | 0x80;
+	*p++ = set;
+	memset(xfd->prev, 0, sizeof(xfd->prev));
+	memcpy(xfd->prev, addr, alen);
+	msg->len = p - msg->data;
+	msg->n++;
+	return true;
+}
+
+/* call with xfd and rcu read locks held */
+static bool xeth_fibdump_entry(struct net_device *mux, struct xeth_fibdump *xfd,
+			       struct fib_entry_notifier_info *feni)
+{
+	struct fib_info *fi = feni->fi;
+	u64 net = xeth_sbtx_net_inum(feni->info.net);
+	struct xeth_next_hop *nh = xfd->scratch;
+	__be32 address = htonl(feni->dst);
+	u32 nhid = 0, set;
+	int i, nhs = 0;
+
+	if (fi->nh && xeth_sbtx_has_nexthop_objects(mux)) {
+		xeth_nh_export(mux, net, fi->nh);
+		nhid = fi->nh->id;
+	} else {
+		nhs = fib_info_num_path(fi);
+		if (nhs * sizeof(*nh) > xeth_fibdump_max_nhset)
+			return false;
+		memset(nh, 0, nhs * sizeof(*nh));
+		for (i = 0; i < nhs; i++) {
+			struct fib_nh_common *nhc = fib_info_nhc(fi, i);
+			nh[i].ifindex = nhc->nhc_dev ?
+				nhc->nhc_dev->ifindex : 0;
+			nh[i].weight = nhc->nhc_weight;
+			nh[i].flags = nhc->nhc_flags;
+			nh[i].gw = nhc->nhc_gw.ipv4;
+			nh[i].scope = nhc->nhc_scope;
+		}
+	}
+	set = xeth_fibdump_set(mux, xfd, net, AF_INET, nhid, nhs,
+			       nhs * sizeof(*nh));
+	return set && xeth_fibdump_record(mux, xfd, net, feni->tb_id, AF_INET,
+					  (u8 *)&address, feni->dst_len,
+					  feni->type, feni->tos, set);
+}
+
+static void xeth_fibdump_nh6(struct xeth_next_hop6 *nh,
+			     struct fib_nh_common *nhc)
+{
+	nh->ifindex = nhc->nhc_dev ? nhc->nhc_dev->ifindex : 0;
+	nh->weight = nhc->nhc_weight;
+	nh->flags = nhc->nhc_flags;
+	memcpy(nh->gw, &nhc->nhc_gw.ipv6, 16);
+}
+
+/* call with xfd and rcu read locks held */
+static bool xeth_fibdump_entry6(struct net_device *mux,
+				struct xeth_fibdump *xfd,
+				struct fib6_entry_notifier_info *feni)
+{
+	struct fib6_info *f6i = feni->rt, *iter;
+	u64 net = xeth_sbtx_net_inum(feni->info.net);
+	struct xeth_next_hop6 *nh = xfd->scratch;
+	const size_t max = xeth_fibdump_max_nhset / sizeof(*nh);
+	struct nh_group *nhg;
+	struct nh_info *nhi;
+	u32 nhid = 0, set;
+	int i, nhs = 0;
+
+	if (f6i->nh && xeth_sbtx_has_nexthop_objects(mux)) {
+		xeth_nh_export(mux, net, f6i->nh);
+		nhid = f6i->nh->id;
+	} else if (f6i->nh && f6i->nh->is_group) {
+		nhg = rcu_dereference(f6i->nh->nh_grp);
+		if (nhg->num_nh > max)
+			return false;
+		for (; nhs < nhg->num_nh; nhs++) {
+			nhi = rcu_dereference(nhg->nh_entries[nhs].nh->nh_info);
+			memset(&nh[nhs], 0, sizeof(*nh));
+			xeth_fibdump_nh6(&nh[nhs], &nhi->fib_nhc);
+		}
+	} else if (f6i->nh) {
+		nhi = rcu_dereference(f6i->nh->nh_info);
+		memset(&nh[nhs], 0, sizeof(*nh));
+		xeth_fibdump_nh6(&nh[nhs++], &nhi->fib_nhc);
+	} else {
+		if (f6i->fib6_nsiblings + 1 > max)
+			return false;
+		memset(&nh[nhs], 0, sizeof(*nh));
+		xeth_fibdump_nh6(&nh[nhs++], &f6i->fib6_nh->nh_common);
+		i = 0;
+		list_for_each_entry_rcu(iter, &f6i->fib6_siblings,
+					fib6_siblings) {
+			if (i++ >= f6i->fib6_nsiblings)
+				break;
+			memset(&nh[nhs], 0, sizeof(*nh));
+			xeth_fibdump_nh6(&nh[nhs++],
+					 &iter->fib6_nh->nh_common);
+		}
+	}
+	set = xeth_fibdump_set(mux, xfd, net, AF_INET6, nhid, nhs,
+			       nhs * sizeof(*nh));
+	return set && xeth_fibdump_record(mux, xfd, net,
+					  f6i->fib6_table->tb6_id, AF_INET6,
+					  (u8 *)&f6i->fib6_dst.addr,
+					  f6i->fib6_dst.plen, f6i->fib6_type,
+					  0, set);
+}
+
+/**
+ * xeth_fibdump_event() - encode a replayed route
+ *
+ * Only the dumping task's replay is encoded. Any other event, including
+ * every live change, flushes the pending block so that the requester gets
+ * it first. return true if the event was encoded; otherwise, the caller
+ * should send it as usual.
+ */
+bool xeth_fibdump_event(struct net_device *mux, unsigned long event,
+			struct fib_notifier_info *info)
+{
+	struct xeth_fibdump *xfd = xeth_mux_fibdump(mux);
+	bool encoded = false;
+
+	spin_lock_bh(&xfd->mutex);
+	if (!xfd->dumping)
+		goto xeth_fibdump_event_unlock;
+	if (event == FIB_EVENT_ENTRY_ADD && xeth_mux_dumping(mux)) {
+		rcu_read_lock();
+		if (info->family == AF_INET)
+			encoded = xeth_fibdump_entry(mux, xfd,
+				container_of(info,
+					     struct fib_entry_notifier_info,
+					     info));
+		else if (info->family == AF_INET6)
+			encoded = xeth_fibdump_entry6(mux, xfd,
+				container_of(info,
+					     struct fib6_entry_notifier_info,
+					     info));
+		rcu_read_unlock();
+	}
+	if (!encoded)
+		xeth_fibdump_flush(mux, xfd);
+xeth_fibdump_event_unlock:
+	spin_unlock_bh(&xfd->mutex);
+	return encoded;
+}
+
+int xeth_fibdump_begin(struct net_device *mux)
+{
+	struct xeth_fibdump *xfd = xeth_mux_fibdump(mux);
+	void *scratch;
+
+	scratch = kmalloc(XETH_SIZEOF_JUMBO_FRAME, GFP_KERNEL);
+	if (!scratch)
+		return -ENOMEM;
+	spin_lock_bh(&xfd->mutex);
+	xfd->scratch = scratch;
+	xfd->sets = 0;
+	xfd->dumping = true;
+	spin_unlock_bh(&xfd->mutex);
+	return 0;
+}
+
+void xeth_fibdump_end(struct net_device *mux)
+{
+	struct xeth_fibdump *xfd = xeth_mux_fibdump(mux);
+	struct xeth_fibdump_set *set;
+	struct hlist_node *tmp;
+	void *scratch;
+	int bkt;
+
+	spin_lock_bh(&xfd->mutex);
+	xeth_fibdump_flush(mux, xfd);
+	xfd->dumping = false;
+	hash_for_each_safe(xfd->ht, bkt, tmp, set, node) {
+		hash_del(&set->node);
+		kfree(set);
+	}
+	scratch = xfd->scratch;
+	xfd->scratch = NULL;
+	spin_unlock_bh(&xfd->mutex);
+	kfree(scratch);
+}
@@ -0,0 +1,53 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0
+ * Copyright(c) 2018-2020 Platina Systems, Inc.
+ *
+ * Contact Information:
+ * sw@platina.com
+ * Platina Systems, 3180 Del La Cruz Blvd, Santa Clara, CA 95054
+ */
+
+#ifndef __NET_ETHERNET_XETH_FIBDUMP_H
+#define __NET_ETHERNET_XETH_FIBDUMP_H
+
+#include <linux/netdevice.h>
+#include <linux/hashtable.h>
+#include <net/fib_notifier.h>
+
+enum {
+	xeth_fibdump_hash_bits = 8,
+};
+
+struct xeth_sbtxb;
+
+/**
+ * struct xeth_fibdump - compact FIB dump encoder
+ * @dumping: replay in progress
+ * @sbtxb: the FIBDUMP message being filled
+ * @net, @table, @family: the key of @sbtxb records
+ * @prev: address of the previous record in @sbtxb
+ * @sets: the number of nexthop sets sent this dump
+ * @scratch: nexthop set encoding buffer
+ */
+struct xeth_fibdump {
+	spinlock_t mutex;
+	bool dumping;
+	struct xeth_sbtxb *sbtxb;
+	u64 net;
+	u32 table;
+	u8 family;
+	u8 prev[16];
+	u32 sets;
+	void *scratch;
+	DECLARE_HASHTABLE(ht, xeth_fibdump_hash_bits);
+};
+
+struct xeth_fibdump *xeth_mux_fibdump(struct net_device *mux);
+
+void xeth_fibdump_init(struct xeth_fibdump *);
+int xeth_fibdump_begin(struct net_device *mux);
+void xeth_fibdump_end(struct net_device *mux);
+bool xeth_fibdump_event(struct net_device *mux, unsigned long event,
+			struct fib_notifier_info *info);
+
+#endif	/* __NET_ETHERNET_XETH_FIBDUMP_H */
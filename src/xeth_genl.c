@@ -0,0 +1,185 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0
+ * Copyright(c) 2018-2020 Platina Systems, Inc.
+ *
+ * Contact Information:
+ * sw@platina.com
+ * Platina Systems, 3180 Del La Cruz Blvd, Santa Clara, CA 95054
+ */
+
+#include "xeth_genl.h"
+#include "xeth_mux.h"
+#include "xeth_sbrx.h"
+#include "xeth_debug.h"
+#include <net/genetlink.h>
+
+static bool xeth_genl_registered;
+
+static const struct nla_policy xeth_genl_policy[XETH_GENL_A_MAX + 1] = {
+	[XETH_GENL_A_MUX] = { .type = NLA_U32 },
+	[XETH_GENL_A_MSG] = {
+		.type = NLA_BINARY,
+		.len = XETH_SIZEOF_JUMBO_FRAME,
+	},
+};
+
+static int xeth_genl_msg_doit(struct sk_buff *skb, struct genl_info *info)
+{
+	struct nlattr *attr = info->attrs[XETH_GENL_A_MSG];
+	struct net_device *mux;
+	void *data;
+	int err;
+
+	if (!info->attrs[XETH_GENL_A_MUX] || !attr)
+		return -EINVAL;
+	mux = dev_get_by_index(genl_info_net(info),
+			       nla_get_u32(info->attrs[XETH_GENL_A_MUX]));
+	if (!mux)
+		return -ENODEV;
+	if (!is_xeth_mux(mux)) {
+		dev_put(mux);
+		return -ENODEV;
+	}
+	/* an aligned, full frame copy like the other transports receive */
+	data = kzalloc(XETH_SIZEOF_JUMBO_FRAME, GFP_KERNEL);
+	if (!data) {
+		dev_put(mux);
+		return -ENOMEM;
+	}
+	memcpy(data, nla_data(attr), nla_len(attr));
+	err = xeth_sbrx_genl(mux, data, nla_len(attr));
+	kfree(data);
+	dev_put(mux);
+	return err;
+}
+
+static const struct genl_ops xeth_genl_ops[] = {
+	{
+		.cmd = XETH_GENL_CMD_MSG,
+		.doit = xeth_genl_msg_doit,
+		.flags = GENL_ADMIN_PERM,
+	},
+};
+
+static const struct genl_multicast_group xeth_genl_mcgrps[] = {
+	[XETH_GENL_MCGRP_LINK] = { .name = XETH_GENL_MCGRP_LINK_NAME },
+	[XETH_GENL_MCGRP_ADDR] = { .name = XETH_GENL_MCGRP_ADDR_NAME },
+	[XETH_GENL_MCGRP_FIB] = { .name = XETH_GENL_MCGRP_FIB_NAME },
+	[XETH_GENL_MCGRP_NEIGH] = { .name = XETH_GENL_MCGRP_NEIGH_NAME },
+	[XETH_GENL_MCGRP_STATS] = { .name = XETH_GENL_MCGRP_STATS_NAME },
+};
+
+static struct genl_family xeth_genl_family __ro_after_init = {
+	.name = XETH_GENL_NAME,
+	.version = XETH_GENL_VERSION,
+	.maxattr = XETH_GENL_A_MAX,
+	.policy = xeth_genl_policy,
+	.netnsok = true,
+	/* a dump requested by XETH_GENL_CMD_MSG may replay the whole FIB;
+	 * it's serialized by the mux rather than blocking all families
+	 */
+	.parallel_ops = true,
+	.module = THIS_MODULE,
+	.ops = xeth_genl_ops,
+	.n_ops = ARRAY_SIZE(xeth_genl_ops),
+	.mcgrps = xeth_genl_mcgrps,
+	.n_mcgrps = ARRAY_SIZE(xeth_genl_mcgrps),
+};
+
+int xeth_genl_register(void)
+{
+	int err = genl_register_family(&xeth_genl_family);
+
+	xeth_genl_registered = !err;
+	return err;
+}
+
+void xeth_genl_unregister(void)
+{
+	if (xeth_genl_registered)
+		genl_unregister_family(&xeth_genl_family);
+	xeth_genl_registered = false;
+}
+
+/* return the bitmask of groups for the message kind */
+static unsigned long xeth_genl_groups(const struct xeth_msg_header *msg)
+{
+	switch (msg->kind) {
+	case XETH_MSG_KIND_BREAK:
+		return BIT(XETH_GENL_MCGRP_LINK) | BIT(XETH_GENL_MCGRP_ADDR) |
+			BIT(XETH_GENL_MCGRP_FIB) | BIT(XETH_GENL_MCGRP_NEIGH);
+	case XETH_MSG_KIND_IFINFO:
+	case XETH_MSG_KIND_CARRIER:
+	case XETH_MSG_KIND_SPEED:
+	case XETH_MSG_KIND_CHANGE_UPPER_XID:
+	case XETH_MSG_KIND_ETHTOOL_FLAGS:
+	case XETH_MSG_KIND_ETHTOOL_SETTINGS:
+	case XETH_MSG_KIND_ETHTOOL_LINK_MODES_SUPPORTED:
+	case XETH_MSG_KIND_ETHTOOL_LINK_MODES_ADVERTISING:
+	case XETH_MSG_KIND_ETHTOOL_LINK_MODES_LP_ADVERTISING:
+	case XETH_MSG_KIND_NETNS_ADD:
+	case XETH_MSG_KIND_NETNS_DEL:
+	case XETH_MSG_KIND_QSFP:
+		return BIT(XETH_GENL_MCGRP_LINK);
+	case XETH_MSG_KIND_IFA:
+	case XETH_MSG_KIND_IFA6:
+		return BIT(XETH_GENL_MCGRP_ADDR);
+	case XETH_MSG_KIND_FIBENTRY:
+	case XETH_MSG_KIND_FIB6ENTRY:
+	case XETH_MSG_KIND_FIBNHENTRY:
+	case XETH_MSG_KIND_FIBDUMP:
+	case XETH_MSG_KIND_FIBDUMP_NHSET:
+	case XETH_MSG_KIND_NEXTHOP:
+	case XETH_MSG_KIND_NEXTHOP_GROUP:
+		return BIT(XETH_GENL_MCGRP_FIB);
+	case XETH_MSG_KIND_NEIGH_UPDATE:
+		return BIT(XETH_GENL_MCGRP_NEIGH);
+	case XETH_MSG_KIND_LINK_STAT:
+	case XETH_MSG_KIND_ETHTOOL_STAT:
+	case XETH_MSG_KIND_STATS_REQUEST:
+	case XETH_MSG_KIND_LINK_STATS:
+	case XETH_MSG_KIND_ETHTOOL_STATS:
+		return BIT(XETH_GENL_MCGRP_STATS);
+	}
+	return 0;
+}
+
+/**
+ * xeth_genl_event() - multicast a side-band message to its groups
+ *
+ * This may be called from atomic context; nothing is allocated for groups
+ * without listeners in the mux netns.
+ */
+void xeth_genl_event(struct net_device *mux, const void *data, size_t len)
+{
+	struct net *net = dev_net(mux);
+	unsigned long groups;
+	struct sk_buff *skb;
+	void *hdr;
+	int group;
+
+	if (!xeth_genl_registered)
+		return;
+	groups = xeth_genl_groups(data);
+	for_each_set_bit(group, &groups, XETH_GENL_N_MCGRPS) {
+		if (!genl_has_listeners(&xeth_genl_family, net, group))
+			continue;
+		skb = genlmsg_new(nla_total_size(sizeof(u32)) +
+				  nla_total_size(len), GFP_ATOMIC);
+		if (!skb) {
+			xeth_mux_inc_sbtx_no_mem(mux);
+			return;
+		}
+		hdr = genlmsg_put(skb, 0, 0, &xeth_genl_family, 0,
+				  XETH_GENL_CMD_EVENT);
+		if (!hdr ||
+		    nla_put_u32(skb, XETH_GENL_A_MUX, mux->ifindex) ||
+		    nla_put(skb, XETH_GENL_A_MSG, len, data)) {
+			nlmsg_free(skb);
+			return;
+		}
+		genlmsg_end(skb, hdr);
+		genlmsg_multicast_netns(&xeth_genl_family, net, skb, 0, group,
+					GFP_ATOMIC);
+	}
+}
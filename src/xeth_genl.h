@@ -0,0 +1,21 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0
+ * Copyright(c) 2018-2020 Platina Systems, Inc.
+ *
+ * Contact Information:
+ * sw@platina.com
+ * Platina Systems, 3180 Del La Cruz Blvd, Santa Clara, CA 95054
+ */
+
+#ifndef __NET_ETHERNET_XETH_GENL_H
+#define __NET_ETHERNET_XETH_GENL_H
+
+#include "xeth.h"
+#include <linux/netdevice.h>
+
+int xeth_genl_register(void);
+void xeth_genl_unregister(void);
+
+void xeth_genl_event(struct net_device *mux, const void *data, size_t len);
+
+#endif	/* __NET_ETHERNET_XETH_GENL_H */
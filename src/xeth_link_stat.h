@@ -64,33 +64,44 @@ xeth_link_stat_ops(RX_COMPRESSED)
 xeth_link_stat_ops(TX_COMPRESSED)
 xeth_link_stat_ops(RX_NOHANDLER)
 
+static inline void xeth_link_stats64(struct rtnl_link_stats64 *dst,
+				     const u64 *src)
+{
+	dst->rx_packets = src[XETH_LINK_STAT_RX_PACKETS];
+	dst->tx_packets = src[XETH_LINK_STAT_TX_PACKETS];
+	dst->rx_bytes = src[XETH_LINK_STAT_RX_BYTES];
+	dst->tx_bytes = src[XETH_LINK_STAT_TX_BYTES];
+	dst->rx_errors = src[XETH_LINK_STAT_RX_ERRORS];
+	dst->tx_errors = src[XETH_LINK_STAT_TX_ERRORS];
+	dst->rx_dropped = src[XETH_LINK_STAT_RX_DROPPED];
+	dst->tx_dropped = src[XETH_LINK_STAT_TX_DROPPED];
+	dst->multicast = src[XETH_LINK_STAT_MULTICAST];
+	dst->collisions = src[XETH_LINK_STAT_COLLISIONS];
+	dst->rx_length_errors = src[XETH_LINK_STAT_RX_LENGTH_ERRORS];
+	dst->rx_over_errors = src[XETH_LINK_STAT_RX_OVER_ERRORS];
+	dst->rx_crc_errors = src[XETH_LINK_STAT_RX_CRC_ERRORS];
+	dst->rx_frame_errors = src[XETH_LINK_STAT_RX_FRAME_ERRORS];
+	dst->rx_fifo_errors = src[XETH_LINK_STAT_RX_FIFO_ERRORS];
+	dst->rx_missed_errors = src[XETH_LINK_STAT_RX_MISSED_ERRORS];
+	dst->tx_aborted_errors = src[XETH_LINK_STAT_TX_ABORTED_ERRORS];
+	dst->tx_carrier_errors = src[XETH_LINK_STAT_TX_CARRIER_ERRORS];
+	dst->tx_fifo_errors = src[XETH_LINK_STAT_TX_FIFO_ERRORS];
+	dst->tx_heartbeat_errors = src[XETH_LINK_STAT_TX_HEARTBEAT_ERRORS];
+	dst->tx_window_errors = src[XETH_LINK_STAT_TX_WINDOW_ERRORS];
+	dst->rx_compressed = src[XETH_LINK_STAT_RX_COMPRESSED];
+	dst->tx_compressed = src[XETH_LINK_STAT_TX_COMPRESSED];
+	dst->rx_nohandler = src[XETH_LINK_STAT_RX_NOHANDLER];
+}
+
 static inline void xeth_link_stats(struct rtnl_link_stats64 *dst,
 				   atomic64_t *src)
 {
-	dst->rx_packets = xeth_get_RX_PACKETS(src);
-	dst->tx_packets = xeth_get_TX_PACKETS(src);
-	dst->rx_bytes = xeth_get_RX_BYTES(src);
-	dst->tx_bytes = xeth_get_TX_BYTES(src);
-	dst->rx_errors = xeth_get_RX_ERRORS(src);
-	dst->tx_errors = xeth_get_TX_ERRORS(src);
-	dst->rx_dropped = xeth_get_RX_DROPPED(src);
-	dst->tx_dropped = xeth_get_TX_DROPPED(src);
-	dst->multicast = xeth_get_MULTICAST(src);
-	dst->collisions = xeth_get_COLLISIONS(src);
-	dst->rx_length_errors = xeth_get_RX_LENGTH_ERRORS(src);
-	dst->rx_over_errors = xeth_get_RX_OVER_ERRORS(src);
-	dst->rx_crc_errors = xeth_get_RX_CRC_ERRORS(src);
-	dst->rx_frame_errors = xeth_get_RX_FRAME_ERRORS(src);
-	dst->rx_fifo_errors = xeth_get_RX_FIFO_ERRORS(src);
-	dst->rx_missed_errors = xeth_get_RX_MISSED_ERRORS(src);
-	dst->tx_aborted_errors = xeth_get_TX_ABORTED_ERRORS(src);
-	dst->tx_carrier_errors = xeth_get_TX_CARRIER_ERRORS(src);
-	dst->tx_fifo_errors = xeth_get_TX_FIFO_ERRORS(src);
-	dst->tx_heartbeat_errors = xeth_get_TX_HEARTBEAT_ERRORS(src);
-	dst->tx_window_errors = xeth_get_TX_WINDOW_ERRORS(src);
-	dst->rx_compressed = xeth_get_RX_COMPRESSED(src);
-	dst->tx_compressed = xeth_get_TX_COMPRESSED(src);
-	dst->rx_nohandler = xeth_get_RX_NOHANDLER(src);
+	u64 t[XETH_N_LINK_STAT];
+	enum xeth_link_stat s;
+
+	for (s = 0; s < XETH_N_LINK_STAT; s++)
+		t[s] = atomic64_read(&src[s]);
+	xeth_link_stats64(dst, t);
 }
 
 #endif	/* __NET_ETHERNET_XETH_LINK_STAT_H */
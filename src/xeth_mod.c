@@ -13,6 +13,7 @@
 #include "xeth_vlan.h"
 #include "xeth_port.h"
 #include "xeth_mux.h"
+#include "xeth_genl.h"
 #include "xeth_version.h"
 #include <linux/module.h>
 
@@ -40,12 +41,14 @@ static int __init xeth_mod_init(void)
 {
 	struct platform_driver * const *drvr = NULL;
 	struct rtnl_link_ops * const *lnko = NULL;
-	int err;
+	int err = 0;
 
 	for (drvr = xeth_mod_drivers; err >= 0 && (*drvr); drvr++)
 		err = platform_driver_register(*drvr);
 	for (lnko = xeth_mod_lnkos; err >= 0 && (*lnko); lnko++)
 		err = rtnl_link_register(*lnko);
+	if (err >= 0)
+		err = xeth_genl_register();
 	if (err) {
 		while (drvr != xeth_mod_drivers)
 			platform_driver_unregister(*(--drvr));
@@ -61,6 +64,7 @@ static void __exit xeth_mod_exit(void)
 	struct platform_driver * const *drvr = NULL;
 	struct rtnl_link_ops * const *lnko = NULL;
 
+	xeth_genl_unregister();
 	for (drvr = xeth_mod_drivers; *drvr; drvr++)
 		platform_driver_unregister(*drvr);
 	for (lnko = xeth_mod_lnkos; *lnko; lnko++)
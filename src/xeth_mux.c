@@ -8,9 +8,14 @@
  */
 
 #include "xeth_mux.h"
+#include "xeth_fibdump.h"
+#include "xeth_genl.h"
 #include "xeth_link_stat.h"
 #include "xeth_nb.h"
+#include "xeth_neigh.h"
+#include "xeth_nh.h"
 #include "xeth_proxy.h"
+#include "xeth_ring.h"
 #include "xeth_sbrx.h"
 #include "xeth_sbtx.h"
 #include "xeth_port.h"
@@ -24,6 +29,9 @@
 #include <linux/un.h>
 #include <linux/i2c.h>
 #include <linux/of_device.h>
+#include <linux/sched/task.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
 
 static const char xeth_mux_drvname[] = "xeth-mux";
 
@@ -34,12 +42,52 @@ enum {
 	xeth_mux_link_hash_bkts = 1 << xeth_mux_link_hash_bits,
 	xeth_mux_max_links = 8,
 	xeth_mux_max_qsfp_i2c_addrs = 3,
+	xeth_mux_sb_hash_bits = 10,
+};
+
+static uint xeth_mux_journal = 4096;
+
+module_param_named(journal, xeth_mux_journal, uint, 0644);
+MODULE_PARM_DESC(journal, " side-band messages kept for controller resync");
+
+static uint xeth_mux_highwater = 16384;
+
+module_param_named(highwater, xeth_mux_highwater, uint, 0644);
+MODULE_PARM_DESC(highwater, " unsent side-band messages before a client is "
+		 "dropped to resync; a dump doesn't count, so this need only "
+		 "exceed the journal and the churn while a client catches up "
+		 "with a dump, not the route table size");
+
+static uint xeth_mux_hold;
+
+module_param_named(hold, xeth_mux_hold, uint, 0644);
+MODULE_PARM_DESC(hold, " ms to hold port carrier for a restarting controller");
+
+static const u64 xeth_mux_kernel_caps =
+	XETH_CAP_NEXTHOP_OBJECTS | XETH_CAP_FIBDUMP_COMPACT |
+	XETH_CAP_STATS_PULL;
+
+/**
+ * struct xeth_mux_stat_table - ethtool stat names of all ports
+ *
+ * The table is replaced, never changed, once published.
+ */
+struct xeth_mux_stat_table {
+	struct rcu_head rcu;
+	size_t named;
+	char names[][ETH_GSTRING_LEN];
 };
 
 struct xeth_mux_priv {
 	struct net_device *nd;
 	struct xeth_nb nb;
+	struct xeth_nh nh;
+	struct xeth_neigh neigh;
+	struct xeth_fibdump fibdump;
+	struct xeth_ring_dev *ring;
 	struct task_struct *main;
+	/* @hold: warm restart hold, then reconcile, timer */
+	struct delayed_work hold;
 	struct net_device *link[xeth_mux_link_hash_bkts];
 	struct {
 		struct mutex mutex;
@@ -51,18 +99,47 @@ struct xeth_mux_priv {
 	volatile unsigned long flags;
 	struct {
 		spinlock_t mutex;
-		struct socket *conn;
-		struct list_head free, tx;
-		void *rx;
+		/* @session: serializes the first connect and last disconnect */
+		struct mutex session;
+		/* @dump: serializes dumps and notifier registration */
+		struct mutex dump;
+		/* @dump_from, @dump_to: numbers of the first message of the
+		 * last dump and the first after it, U64_MAX while dumping
+		 */
+		u64 dump_from, dump_to;
+		/* @dump_task: the task running a dump, if any, which alone
+		 * addresses its messages to @dump_dest and @dump_client
+		 */
+		struct task_struct *dump_task;
+		u8 dump_dest;
+		unsigned int dump_client;
+		/* @dumps: numbers each dump */
+		u32 dumps;
+		struct list_head clients;
+		/* @log: messages by sequence, pending or kept for resync */
+		struct list_head free, log;
+		/* @seq: next sequence number to assign */
+		u64 seq, epoch;
+		/* @trimmed: highest sequence number dropped from the log */
+		u64 trimmed;
+		/* @gen: count of logged barriers */
+		u32 gen;
+		/* @caps: XETH_CAP_* in effect, see xeth_mux_update_caps() */
+		u64 caps;
+		/* @wq: wait for clients to close */
+		wait_queue_head_t wq;
+		/* @keyed: latest logged message of each key */
+		DECLARE_HASHTABLE(keyed, xeth_mux_sb_hash_bits);
+		unsigned int ids;
 	} sb;
 	struct {
 		char names[xeth_mux_max_flags][ETH_GSTRING_LEN];
 		size_t named;
 	} priv_flags;
 	struct xeth_mux_stat_name {
+		/* @mutex: writers of @table; readers use RCU */
 		struct mutex mutex;
-		char names[xeth_mux_max_stats][ETH_GSTRING_LEN];
-		size_t named;
+		struct xeth_mux_stat_table __rcu *table;
 		bool sysfs;
 	} stat_name;
 	struct gpio_descs *absent_gpios;
@@ -95,12 +172,12 @@ static void xeth_mux_unlock_proxy(struct xeth_mux_priv *priv)
 
 static void xeth_mux_lock_sb(struct xeth_mux_priv *priv)
 {
-	spin_lock(&priv->sb.mutex);
+	spin_lock_bh(&priv->sb.mutex);
 }
 
 static void xeth_mux_unlock_sb(struct xeth_mux_priv *priv)
 {
-	spin_unlock(&priv->sb.mutex);
+	spin_unlock_bh(&priv->sb.mutex);
 }
 
 static inline void xeth_mux_lock_stat_name(struct xeth_mux_priv *priv)
@@ -113,13 +190,23 @@ static inline void xeth_mux_unlock_stat_name(struct xeth_mux_priv *priv)
 	mutex_unlock(&priv->stat_name.mutex);
 }
 
+static void xeth_mux_hold_expired(struct work_struct *work);
+
 static void xeth_mux_priv_init(struct xeth_mux_priv *priv)
 {
 	int i;
 
 	mutex_init(&priv->proxy.mutex);
 	spin_lock_init(&priv->sb.mutex);
+	mutex_init(&priv->sb.session);
+	mutex_init(&priv->sb.dump);
+	init_waitqueue_head(&priv->sb.wq);
 	mutex_init(&priv->stat_name.mutex);
+	INIT_DELAYED_WORK(&priv->hold, xeth_mux_hold_expired);
+	xeth_nb_init(&priv->nb);
+	xeth_nh_init(&priv->nh);
+	xeth_neigh_init(&priv->neigh);
+	xeth_fibdump_init(&priv->fibdump);
 
 	for (i = 0; i < xeth_mux_proxy_hash_bkts; i++)
 		INIT_HLIST_HEAD(&priv->proxy.hls[i]);
@@ -130,7 +217,12 @@ static void xeth_mux_priv_init(struct xeth_mux_priv *priv)
 	INIT_LIST_HEAD_RCU(&priv->proxy.lbs);
 
 	INIT_LIST_HEAD(&priv->sb.free);
-	INIT_LIST_HEAD(&priv->sb.tx);
+	INIT_LIST_HEAD(&priv->sb.clients);
+	INIT_LIST_HEAD(&priv->sb.log);
+	hash_init(priv->sb.keyed);
+	priv->sb.seq = 1;
+	priv->sb.epoch = ktime_get_real_ns();
+	priv->sb.caps = xeth_mux_kernel_caps;
 }
 
 struct xeth_nb *xeth_mux_nb(struct net_device *mux)
@@ -139,6 +231,24 @@ struct xeth_nb *xeth_mux_nb(struct net_device *mux)
 	return &priv->nb;
 }
 
+struct xeth_nh *xeth_mux_nh(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+	return &priv->nh;
+}
+
+struct xeth_neigh *xeth_mux_neigh(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+	return &priv->neigh;
+}
+
+struct xeth_fibdump *xeth_mux_fibdump(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+	return &priv->fibdump;
+}
+
 struct net_device *xeth_mux_of_nb(struct xeth_nb *nb)
 {
 	struct xeth_mux_priv *priv =
@@ -180,22 +290,61 @@ void xeth_mux_priv_flag_names(struct net_device *mux, char *buf)
 
 size_t xeth_mux_n_stats(struct net_device *mux)
 {
-	size_t n;
 	struct xeth_mux_priv *priv = netdev_priv(mux);
-	xeth_mux_lock_stat_name(priv);
-	n = priv->stat_name.named;
-	xeth_mux_unlock_stat_name(priv);
+	struct xeth_mux_stat_table *table;
+	size_t n;
+
+	rcu_read_lock();
+	table = rcu_dereference(priv->stat_name.table);
+	n = table ? table->named : 0;
+	rcu_read_unlock();
 	return n;
 }
 
-void xeth_mux_stat_names(struct net_device *mux, char *buf)
+/* Copy up to @max names to @buf; return the number copied. */
+size_t xeth_mux_stat_names(struct net_device *mux, char *buf, size_t max)
 {
-	int i;
 	struct xeth_mux_priv *priv = netdev_priv(mux);
-	xeth_mux_lock_stat_name(priv);
-	for (i = 0; i < priv->stat_name.named; i++, buf += ETH_GSTRING_LEN)
-		strncpy(buf, priv->stat_name.names[i], ETH_GSTRING_LEN);
-	xeth_mux_unlock_stat_name(priv);
+	struct xeth_mux_stat_table *table;
+	size_t n;
+
+	rcu_read_lock();
+	table = rcu_dereference(priv->stat_name.table);
+	n = table ? min(table->named, max) : 0;
+	if (n)
+		memcpy(buf, table->names, n * ETH_GSTRING_LEN);
+	rcu_read_unlock();
+	return n;
+}
+
+/* Publish a new table of @n names, keeping the first @keep of the old one.
+ * Call with stat_name mutex held.
+ */
+static int xeth_mux_publish_stat_names(struct xeth_mux_priv *priv,
+				       size_t keep, const char *names,
+				       size_t n)
+{
+	struct xeth_mux_stat_table *old, *table = NULL;
+
+	old = rcu_dereference_protected(priv->stat_name.table,
+		lockdep_is_held(&priv->stat_name.mutex));
+	if (keep + n) {
+		table = kzalloc(struct_size(table, names, keep + n),
+				GFP_KERNEL);
+		if (!table)
+			return -ENOMEM;
+		if (keep)
+			memcpy(table->names, old->names,
+			       keep * ETH_GSTRING_LEN);
+		if (n)
+			memcpy(table->names[keep], names,
+			       n * ETH_GSTRING_LEN);
+		table->named = keep + n;
+	}
+	rcu_assign_pointer(priv->stat_name.table, table);
+	if (old)
+		kfree_rcu(old, rcu);
+	return 0;
 }
 
 static ssize_t xeth_mux_show_stat_name(struct device *dev,
@@ -207,6 +356,9 @@ static ssize_t xeth_mux_show_stat_name(struct device *dev,
 	return scnprintf(buf, PAGE_SIZE, "%zd", xeth_mux_n_stats(mux));
 }
 
+/* Append each line of @buf to the names, or clear them with an empty
+ * write; the new names are published together.
+ */
 static ssize_t xeth_mux_store_stat_name(struct device *dev,
 					struct device_attribute *attr,
 					const char *buf, size_t sz)
@@ -214,30 +366,40 @@ static ssize_t xeth_mux_store_stat_name(struct device *dev,
 	struct net_device *mux =
 		container_of(dev, struct net_device, dev);
 	struct xeth_mux_priv *priv = netdev_priv(mux);
-	char *name;
-	int i;
+	struct xeth_mux_stat_table *table;
+	char (*names)[ETH_GSTRING_LEN];
+	size_t named, n = 0, i = 0, len;
+	int err;
 
 	if (!sz || buf[0] == '\n') {
 		xeth_mux_lock_stat_name(priv);
-		priv->stat_name.named = 0;
+		err = xeth_mux_publish_stat_names(priv, 0, NULL, 0);
 		xeth_mux_unlock_stat_name(priv);
-		return sz;
+		return err ? err : sz;
 	}
-	xeth_mux_lock_stat_name(priv);
-	if (priv->stat_name.named >= xeth_mux_max_stats) {
-		xeth_mux_unlock_stat_name(priv);
-		return -EINVAL;
+	names = kcalloc(xeth_mux_max_stats, ETH_GSTRING_LEN, GFP_KERNEL);
+	if (!names)
+		return -ENOMEM;
+	while (i < sz && n < xeth_mux_max_stats) {
+		len = strcspn(buf + i, "\n");
+		if (len > sz - i)
+			len = sz - i;
+		if (len)
+			strncpy(names[n++], buf + i,
+				min_t(size_t, len, ETH_GSTRING_LEN - 1));
+		i += len + 1;
 	}
-	name = &priv->stat_name.names[priv->stat_name.named][0];
-	for (i = 0; i < ETH_GSTRING_LEN; i++, name++)
-		if (buf[i] == '\n' || i == sz) {
-			*name = '\0';
-			break;
-		} else
-			*name = buf[i];
-	priv->stat_name.named++;
+	xeth_mux_lock_stat_name(priv);
+	table = rcu_dereference_protected(priv->stat_name.table,
+		lockdep_is_held(&priv->stat_name.mutex));
+	named = table ? table->named : 0;
+	if (i < sz || named + n > xeth_mux_max_stats)
+		err = -EINVAL;
+	else
+		err = xeth_mux_publish_stat_names(priv, named, names[0], n);
 	xeth_mux_unlock_stat_name(priv);
-	return sz;
+	kfree(names);
+	return err ? err : sz;
 }
 
 static struct device_attribute xeth_mux_stat_name_attr = {
@@ -439,6 +601,17 @@ void xeth_mux_dump_all_ifinfo(struct net_device *mux)
 	rcu_read_unlock();
 }
 
+/* As the netdevice notifier replays the loopback of each netns. */
+void xeth_mux_dump_all_netns(struct net_device *mux)
+{
+	struct net *net;
+
+	rcu_read_lock();
+	for_each_net_rcu(net)
+		xeth_sbtx_netns(mux, net, true);
+	rcu_read_unlock();
+}
+
 static void xeth_mux_drop_all_port_carrier(struct net_device *mux)
 {
 	struct xeth_mux_priv *priv = netdev_priv(mux);
@@ -461,6 +634,86 @@ static void xeth_mux_reset_all_port_ethtool_stats(struct net_device *mux)
 	rcu_read_unlock();
 }
 
+static void xeth_mux_mark_stale_port_carrier(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+	struct xeth_proxy *proxy;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(proxy, &priv->proxy.ports, kin)
+		proxy->stale = netif_carrier_ok(proxy->nd);
+	rcu_read_unlock();
+}
+
+static void xeth_mux_drop_stale_port_carrier(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+	struct xeth_proxy *proxy;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(proxy, &priv->proxy.ports, kin)
+		if (proxy->stale) {
+			proxy->stale = false;
+			xeth_mux_change_carrier(mux, proxy->nd, false);
+		}
+	rcu_read_unlock();
+}
+
+static void xeth_mux_cold_restart(struct net_device *mux)
+{
+	xeth_mux_drop_all_port_carrier(mux);
+	xeth_mux_reset_all_link_stats(mux);
+	xeth_mux_reset_all_port_ethtool_stats(mux);
+}
+
+/* Without a returning controller, the hold ends in a cold restart;
+ * otherwise, the reconcile period ends by dropping the carrier of any port
+ * that the controller hasn't reasserted.
+ */
+static void xeth_mux_hold_expired(struct work_struct *work)
+{
+	struct xeth_mux_priv *priv =
+		container_of(to_delayed_work(work), struct xeth_mux_priv, hold);
+	struct net_device *mux = priv->nd;
+
+	if (xeth_mux_has_sb_hold(mux)) {
+		xeth_mux_clear_sb_hold(mux);
+		xeth_mux_cold_restart(mux);
+	} else if (xeth_mux_has_sb_reconcile(mux)) {
+		xeth_mux_clear_sb_reconcile(mux);
+		xeth_mux_drop_stale_port_carrier(mux);
+	}
+}
+
+static void xeth_mux_start_session(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+
+	cancel_delayed_work_sync(&priv->hold);
+	if (xeth_mux_has_sb_hold(mux)) {
+		xeth_mux_clear_sb_hold(mux);
+		xeth_mux_mark_stale_port_carrier(mux);
+		xeth_mux_set_sb_reconcile(mux);
+		schedule_delayed_work(&priv->hold,
+				      msecs_to_jiffies(xeth_mux_hold));
+	} else
+		xeth_mux_cold_restart(mux);
+}
+
+static void xeth_mux_end_session(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+
+	cancel_delayed_work_sync(&priv->hold);
+	xeth_mux_clear_sb_reconcile(mux);
+	if (xeth_mux_hold) {
+		xeth_mux_set_sb_hold(mux);
+		schedule_delayed_work(&priv->hold,
+				      msecs_to_jiffies(xeth_mux_hold));
+	} else
+		xeth_mux_drop_all_port_carrier(mux);
+}
+
 atomic64_t *xeth_mux_counters(struct net_device *mux)
 {
 	struct xeth_mux_priv *priv = netdev_priv(mux);
@@ -477,6 +730,14 @@ static const struct ethtool_ops xeth_mux_ethtool_ops;
 static rx_handler_result_t xeth_mux_demux(struct sk_buff **pskb);
 static void xeth_mux_demux_vlan(struct net_device *mux, struct sk_buff *skb);
 
+static void xeth_mux_priv_destructor(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+
+	kfree(rcu_dereference_protected(priv->stat_name.table, true));
+	RCU_INIT_POINTER(priv->stat_name.table, NULL);
+}
+
 static void xeth_mux_setup(struct net_device *mux)
 {
 	struct xeth_mux_priv *priv = netdev_priv(mux);
@@ -484,7 +745,7 @@ static void xeth_mux_setup(struct net_device *mux)
 	mux->netdev_ops = &xeth_mux_ndo;
 	mux->ethtool_ops = &xeth_mux_ethtool_ops;
 	mux->needs_free_netdev = true;
-	mux->priv_destructor = NULL;
+	mux->priv_destructor = xeth_mux_priv_destructor;
 	ether_setup(mux);
 	mux->flags |= IFF_MASTER;
 	mux->priv_flags |= IFF_DONT_BRIDGE;
@@ -615,40 +876,119 @@ static int xeth_mux_validate(struct nlattr *tb[], struct nlattr *data[],
 	return 0;
 }
 
-static int xeth_mux_service_sbrx(void *data)
+/* Side-band transmit classes in strict priority order */
+enum xeth_mux_sb_class {
+	xeth_mux_sb_ctl,
+	xeth_mux_sb_bulk,
+	xeth_mux_sb_classes,
+};
+
+/**
+ * struct xeth_mux_client - a side-band connection
+ * @conn: the socket, or NULL if by @ring
+ * @next: next log entry of each class to send, NULL when caught up
+ * @kinds: bitmask of subscribed xeth_msg_kind
+ * @known: bitmask of xeth_msg_kind that the controller understands
+ * @caps: XETH_CAP_* agreed by HELLO
+ * @txseq: next sequence number expected by the controller
+ * @ackseq: pending SEQ answer to RESYNC, 0 if none
+ * @synced: controller has resync'd or requested a dump
+ * @sequenced: controller understands SEQ messages
+ * @done: the connection is closing
+ * @hello: pending HELLO answer
+ * @overflow: dropped for falling too far behind, see xeth_mux_check_backlog()
+ * @fib_filter: routes the controller takes, NULL for all
+ *
+ * Each client has rx and tx threads and a cursor per class into the mux log;
+ * so a slow client falls behind without stalling the others, and interface
+ * changes reach it ahead of a route or neighbour backlog.
+ */
+struct xeth_mux_client {
+	struct list_head list;
+	struct net_device *mux;
+	struct socket *conn;
+	struct xeth_ring *ring;
+	struct task_struct *rx;
+	wait_queue_head_t wq;
+	struct xeth_sbtxb *next[xeth_mux_sb_classes];
+	u64 kinds, known, caps, txseq, ackseq;
+	void *rxb, *txb;
+	struct xeth_nb_fib_filter *fib_filter;
+	unsigned int id;
+	bool synced, sequenced, done, overflow, hello;
+};
+
+/**
+ * xeth_mux_lock_dump() - hold through a dump requested by @client
+ *
+ * The dump is addressed to its requester alone, or to genl listeners if
+ * @client is NULL, while the live notifiers go on for everyone else. So
+ * every message allocated by the dumping task until the unlock is
+ * addressed to the requester; that includes any that the notifiers
+ * replay as they're registered by the dump. This also marks the dump's
+ * messages for xeth_mux_check_backlog().
+ */
+void xeth_mux_lock_dump(struct net_device *mux, struct xeth_mux_client *client)
 {
-	struct net_device *mux = data;
 	struct xeth_mux_priv *priv = netdev_priv(mux);
-	struct timeval tv = {
-		.tv_sec = 0,
-		.tv_usec = 10000,
-	};
-	int err;
 
-	xeth_mux_set_sbrx_task(mux);
-	err = kernel_setsockopt(priv->sb.conn, SOL_SOCKET, SO_RCVTIMEO_NEW,
-				(char *)&tv, sizeof(tv));
-	if (err)
-		goto xeth_mux_service_sbrx_exit;
+	mutex_lock(&priv->sb.dump);
+	xeth_mux_lock_sb(priv);
+	priv->sb.dump_from = priv->sb.seq;
+	priv->sb.dump_to = U64_MAX;
+	priv->sb.dump_dest = client ?
+		xeth_sbtxb_to_client : xeth_sbtxb_to_genl;
+	priv->sb.dump_client = client ? client->id : 0;
+	priv->sb.dumps++;
+	WRITE_ONCE(priv->sb.dump_task, current);
+	xeth_mux_unlock_sb(priv);
+}
 
-	allow_signal(SIGKILL);
-	while (!err && !kthread_should_stop() && !signal_pending(current))
-		err = xeth_sbrx(mux, priv->sb.conn, priv->sb.rx);
+void xeth_mux_unlock_dump(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+
+	xeth_mux_lock_sb(priv);
+	WRITE_ONCE(priv->sb.dump_task, NULL);
+	priv->sb.dump_to = priv->sb.seq;
+	xeth_mux_unlock_sb(priv);
+	mutex_unlock(&priv->sb.dump);
+}
+
+/* Return the number of the dump if run by the current task, otherwise 0. */
+u32 xeth_mux_dumping(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+
+	/* only the dumping task may find itself here */
+	return READ_ONCE(priv->sb.dump_task) == current ? priv->sb.dumps : 0;
+}
+
+static void xeth_mux_stop_notifiers(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+
+	mutex_lock(&priv->sb.dump);
 	xeth_nb_stop_netevent(mux);
 	xeth_nb_stop_fib(mux);
 	xeth_nb_stop_inetaddr(mux);
 	xeth_nb_stop_netdevice(mux);
-xeth_mux_service_sbrx_exit:
-	xeth_mux_clear_sbrx_task(mux);
-	return err;
+	mutex_unlock(&priv->sb.dump);
 }
 
-static struct task_struct *xeth_mux_fork_sbrx(struct net_device *mux)
+/* Address a message allocated by the dumping task to the dump's requester;
+ * all others are for everyone.
+ */
+static void xeth_mux_address_sbtxb(struct xeth_mux_priv *priv,
+				   struct xeth_sbtxb *sbtxb)
 {
-	struct task_struct *t;
-
-	t = kthread_run(xeth_mux_service_sbrx, mux, "%s-rx", mux->name);
-	return IS_ERR(t) ? NULL :  t;
+	if (READ_ONCE(priv->sb.dump_task) == current) {
+		sbtxb->to = priv->sb.dump_dest;
+		sbtxb->client = priv->sb.dump_client;
+	} else {
+		sbtxb->to = xeth_sbtxb_to_all;
+		sbtxb->client = 0;
+	}
 }
 
 struct xeth_sbtxb *xeth_mux_alloc_sbtxb(struct net_device *mux, size_t len)
@@ -664,93 +1004,777 @@ struct xeth_sbtxb *xeth_mux_alloc_sbtxb(struct net_device *mux, size_t len)
 			xeth_mux_unlock_sb(priv);
 			xeth_mux_dec_sbtx_free(mux);
 			sbtxb->len = len;
+			sbtxb->after = 0;
+			sbtxb->keylen = 0;
+			sbtxb->pinned = false;
+			sbtxb->barrier = false;
+			sbtxb->sent = false;
+			sbtxb->bulk = false;
+			xeth_mux_address_sbtxb(priv, sbtxb);
 			xeth_sbtxb_zero(sbtxb);
 			return sbtxb;
 		}
 	xeth_mux_unlock_sb(priv);
 	sz = ALIGN(xeth_sbtxb_size + len, 1024);
-	sbtxb = devm_kzalloc(&mux->dev, sz, GFP_KERNEL);
+	/* notifiers may call from atomic context */
+	sbtxb = devm_kzalloc(&mux->dev, sz, GFP_ATOMIC);
+	if (!sbtxb) {
+		xeth_mux_inc_sbtx_no_mem(mux);
+		return NULL;
+	}
 	sbtxb->len = len;
 	sbtxb->sz = sz - xeth_sbtxb_size;
+	xeth_mux_address_sbtxb(priv, sbtxb);
 	return sbtxb;
 }
 
-static void xeth_mux_append_sbtxb(struct net_device *mux,
+/* Return the caps needed to parse the message. Notifiers encode with the
+ * caps read before logging, so a message may be logged after a client
+ * without them syncs; this is what filters it.
+ */
+static u64 xeth_mux_sbtxb_caps(struct xeth_sbtxb *sbtxb)
+{
+	struct xeth_msg_header *msg = xeth_sbtxb_data(sbtxb);
+	struct xeth_msg_fibdump_nhset *nhset = xeth_sbtxb_data(sbtxb);
+
+	switch (msg->kind) {
+	case XETH_MSG_KIND_FIBNHENTRY:
+	case XETH_MSG_KIND_NEXTHOP:
+	case XETH_MSG_KIND_NEXTHOP_GROUP:
+		return XETH_CAP_NEXTHOP_OBJECTS;
+	case XETH_MSG_KIND_FIBDUMP:
+		return XETH_CAP_FIBDUMP_COMPACT;
+	case XETH_MSG_KIND_FIBDUMP_NHSET:
+		return XETH_CAP_FIBDUMP_COMPACT |
+			(nhset->nhid ? XETH_CAP_NEXTHOP_OBJECTS : 0);
+	}
+	return 0;
+}
+
+static bool xeth_mux_sbtxb_is_for(struct xeth_sbtxb *sbtxb,
+				  struct xeth_mux_client *client)
+{
+	switch (sbtxb->to) {
+	case xeth_sbtxb_to_all:
+		return true;
+	case xeth_sbtxb_to_client:
+		return sbtxb->client == client->id;
+	}
+	return false;
+}
+
+/* The kinds of route that a FIB filter narrows. */
+static const u64 xeth_mux_fib_kinds =
+	BIT_ULL(XETH_MSG_KIND_FIBENTRY) | BIT_ULL(XETH_MSG_KIND_FIB6ENTRY) |
+	BIT_ULL(XETH_MSG_KIND_FIBNHENTRY) | BIT_ULL(XETH_MSG_KIND_FIBDUMP);
+
+/* call with sb lock held; the notifier passes the routes of any client's
+ * filter, so this narrows them to the client's own. Deletions always pass
+ * since the client may have the route from before its filter narrowed.
+ */
+static bool xeth_mux_client_fib_allows(struct xeth_mux_client *client,
+				       struct xeth_sbtxb *sbtxb)
+{
+	const struct xeth_nb_fib_filter *filter = client->fib_filter;
+	struct xeth_msg_header *msg = xeth_sbtxb_data(sbtxb);
+	struct xeth_msg_fibentry *fe = xeth_sbtxb_data(sbtxb);
+	struct xeth_msg_fib6entry *f6e = xeth_sbtxb_data(sbtxb);
+	struct xeth_msg_fibnhentry *fnhe = xeth_sbtxb_data(sbtxb);
+	struct xeth_msg_fibdump *fd = xeth_sbtxb_data(sbtxb);
+
+	if (!filter)
+		return true;
+	switch (msg->kind) {
+	case XETH_MSG_KIND_FIBENTRY:
+		return fe->event == FIB_EVENT_ENTRY_DEL ||
+			xeth_nb_fib_filter_allows(filter, fe->net, fe->table,
+						  AF_INET);
+	case XETH_MSG_KIND_FIB6ENTRY:
+		return f6e->event == FIB_EVENT_ENTRY_DEL ||
+			xeth_nb_fib_filter_allows(filter, f6e->net,
+						  f6e->table, AF_INET6);
+	case XETH_MSG_KIND_FIBNHENTRY:
+		return fnhe->event == FIB_EVENT_ENTRY_DEL ||
+			xeth_nb_fib_filter_allows(filter, fnhe->net,
+						  fnhe->table, fnhe->family);
+	case XETH_MSG_KIND_FIBDUMP:
+		return xeth_nb_fib_filter_allows(filter, fd->net, fd->table,
+						 fd->family);
+	}
+	return true;
+}
+
+static bool xeth_mux_client_wants(struct xeth_mux_client *client,
 				  struct xeth_sbtxb *sbtxb)
+{
+	struct xeth_msg_header *msg = xeth_sbtxb_data(sbtxb);
+
+	return xeth_mux_sbtxb_is_for(sbtxb, client) && msg->kind < 64 &&
+		(client->kinds & client->known & BIT_ULL(msg->kind)) &&
+		!(xeth_mux_sbtxb_caps(sbtxb) & ~client->caps) &&
+		xeth_mux_client_fib_allows(client, sbtxb);
+}
+
+/**
+ * xeth_mux_fib_filter() - the union of the FIB filters of the clients that
+ * take routes, for the notifier to drop what none of them want
+ *
+ * Return: a new filter, or NULL to allow all, as when any of those clients
+ * has no filter, there are none and the journal keeps every route for the
+ * next, or there's no memory.
+ */
+struct xeth_nb_fib_filter *xeth_mux_fib_filter(struct net_device *mux)
 {
 	struct xeth_mux_priv *priv = netdev_priv(mux);
+	struct xeth_nb_fib_filter *filter = NULL;
+	struct xeth_mux_client *client;
+	bool all = false;
+	size_t n = 0;
 
 	xeth_mux_lock_sb(priv);
-	list_add_tail(&sbtxb->list, &priv->sb.tx);
+	list_for_each_entry(client, &priv->sb.clients, list) {
+		if (!(client->kinds & client->known & xeth_mux_fib_kinds))
+			continue;
+		if (!client->fib_filter)
+			all = true;
+		else
+			n += client->fib_filter->n;
+	}
+	if (!all && n)
+		filter = kzalloc(struct_size(filter, entries, n), GFP_ATOMIC);
+	if (filter)
+		list_for_each_entry(client, &priv->sb.clients, list)
+			if ((client->kinds & client->known &
+			     xeth_mux_fib_kinds) && client->fib_filter) {
+				memcpy(&filter->entries[filter->n],
+				       client->fib_filter->entries,
+				       client->fib_filter->n *
+				       sizeof(filter->entries[0]));
+				filter->n += client->fib_filter->n;
+			}
 	xeth_mux_unlock_sb(priv);
-	xeth_mux_inc_sbtx_queued(mux);
+	return filter;
 }
 
-static void xeth_mux_prepend_sbtxb(struct net_device *mux,
-				   struct xeth_sbtxb *sbtxb)
+/**
+ * xeth_mux_set_fib_filter() - replace the allow-list of the routes that the
+ * client takes; @n of 0 allows all
+ *
+ * The caller should then xeth_nb_update_fib_filter().
+ */
+int xeth_mux_set_fib_filter(struct xeth_mux_client *client,
+			    const struct xeth_fib_filter_entry *entries,
+			    size_t n)
 {
-	struct xeth_mux_priv *priv = netdev_priv(mux);
+	struct xeth_mux_priv *priv = netdev_priv(client->mux);
+	struct xeth_nb_fib_filter *filter = NULL, *old;
 
+	if (n) {
+		filter = kzalloc(struct_size(filter, entries, n), GFP_KERNEL);
+		if (!filter)
+			return -ENOMEM;
+		filter->n = n;
+		memcpy(filter->entries, entries, n * sizeof(*entries));
+	}
 	xeth_mux_lock_sb(priv);
-	list_add(&sbtxb->list, &priv->sb.tx);
+	old = client->fib_filter;
+	client->fib_filter = filter;
 	xeth_mux_unlock_sb(priv);
-	xeth_mux_inc_sbtx_queued(mux);
+	kfree(old);
+	return 0;
 }
 
-static struct xeth_sbtxb *xeth_mux_pop_sbtxb(struct net_device *mux)
+/* Routes, nexthops and neighbours are bulk; so is the BREAK of a FIB dump,
+ * which must follow its routes, but not that of an ifinfo dump.
+ */
+static enum xeth_mux_sb_class xeth_mux_sbtxb_class(struct xeth_sbtxb *sbtxb)
+{
+	struct xeth_msg_header *msg = xeth_sbtxb_data(sbtxb);
+
+	switch (msg->kind) {
+	case XETH_MSG_KIND_BREAK:
+		return sbtxb->bulk ? xeth_mux_sb_bulk : xeth_mux_sb_ctl;
+	case XETH_MSG_KIND_FIBENTRY:
+	case XETH_MSG_KIND_FIB6ENTRY:
+	case XETH_MSG_KIND_FIBNHENTRY:
+	case XETH_MSG_KIND_FIBDUMP:
+	case XETH_MSG_KIND_FIBDUMP_NHSET:
+	case XETH_MSG_KIND_NEIGH_UPDATE:
+	case XETH_MSG_KIND_NEXTHOP:
+	case XETH_MSG_KIND_NEXTHOP_GROUP:
+		return xeth_mux_sb_bulk;
+	}
+	return xeth_mux_sb_ctl;
+}
+
+/* Interface and netns births and deaths are control messages that don't
+ * overtake earlier bulk, since routes and neighbours may refer to them.
+ */
+static bool xeth_mux_sbtxb_fences(struct xeth_sbtxb *sbtxb)
+{
+	struct xeth_msg_header *msg = xeth_sbtxb_data(sbtxb);
+	struct xeth_msg_ifinfo *ifinfo = xeth_sbtxb_data(sbtxb);
+
+	switch (msg->kind) {
+	case XETH_MSG_KIND_NETNS_ADD:
+	case XETH_MSG_KIND_NETNS_DEL:
+		return true;
+	case XETH_MSG_KIND_IFINFO:
+		switch (ifinfo->reason) {
+		case XETH_IFINFO_REASON_NEW:
+		case XETH_IFINFO_REASON_DEL:
+		case XETH_IFINFO_REASON_REG:
+		case XETH_IFINFO_REASON_UNREG:
+			return true;
+		}
+	}
+	return false;
+}
+
+/* call with sb lock held; return the class of the client's next message,
+ * control unless it's a fence behind the next bulk message
+ */
+static enum xeth_mux_sb_class
+xeth_mux_client_next_class(struct xeth_mux_client *client)
 {
-	struct xeth_mux_priv *priv = netdev_priv(mux);
+	struct xeth_sbtxb *ctl = client->next[xeth_mux_sb_ctl];
+	struct xeth_sbtxb *bulk = client->next[xeth_mux_sb_bulk];
+
+	if (!ctl || (bulk && bulk->seq < ctl->seq &&
+		     xeth_mux_sbtxb_fences(ctl)))
+		return xeth_mux_sb_bulk;
+	return xeth_mux_sb_ctl;
+}
+
+/* call with sb lock held; point the client's @class cursor at its next
+ * wanted entry
+ */
+static void xeth_mux_client_seek(struct xeth_mux_priv *priv,
+				 struct xeth_mux_client *client,
+				 enum xeth_mux_sb_class class,
+				 struct xeth_sbtxb *sbtxb)
+{
+	list_for_each_entry_from(sbtxb, &priv->sb.log, list)
+		if (xeth_mux_sbtxb_class(sbtxb) == class &&
+		    xeth_mux_client_wants(client, sbtxb)) {
+			client->next[class] = sbtxb;
+			return;
+		}
+	client->next[class] = NULL;
+}
+
+/* call with sb lock held; return the client's earliest unsent entry */
+static struct xeth_sbtxb *xeth_mux_client_first(struct xeth_mux_client *client)
+{
+	struct xeth_sbtxb *first = NULL;
+	int class;
+
+	for (class = 0; class < xeth_mux_sb_classes; class++)
+		if (client->next[class] &&
+		    (!first || client->next[class]->seq < first->seq))
+			first = client->next[class];
+	return first;
+}
+
+static void xeth_mux_client_clear(struct xeth_mux_client *client)
+{
+	int class;
+
+	for (class = 0; class < xeth_mux_sb_classes; class++)
+		client->next[class] = NULL;
+}
+
+/* call with sb lock held */
+static bool xeth_mux_log_is_pending(struct xeth_mux_priv *priv,
+				    struct xeth_sbtxb *sbtxb)
+{
+	struct xeth_mux_client *client;
+
+	list_for_each_entry(client, &priv->sb.clients, list)
+		if (client->next[xeth_mux_sbtxb_class(sbtxb)] == sbtxb)
+			return true;
+	return false;
+}
+
+/* call with sb lock held; keep the last journal messages sent by all clients */
+static void xeth_mux_trim_log(struct xeth_mux_priv *priv)
+{
+	struct net_device *mux = priv->nd;
 	struct xeth_sbtxb *sbtxb;
 
-	xeth_mux_lock_sb(priv);
-	sbtxb = list_first_entry_or_null(&priv->sb.tx,
-					 struct xeth_sbtxb, list);
-	if (sbtxb) {
-		list_del(&sbtxb->list);
+	while (xeth_mux_get_sbtx_queued(mux) > xeth_mux_journal) {
+		sbtxb = list_first_entry(&priv->sb.log, struct xeth_sbtxb,
+					 list);
+		if (xeth_mux_log_is_pending(priv, sbtxb))
+			break;
+		if (sbtxb->seq > priv->sb.trimmed)
+			priv->sb.trimmed = sbtxb->seq;
+		if (!hlist_unhashed(&sbtxb->node))
+			hash_del(&sbtxb->node);
+		list_move_tail(&sbtxb->list, &priv->sb.free);
 		xeth_mux_dec_sbtx_queued(mux);
+		xeth_mux_inc_sbtx_free(mux);
 	}
+}
+
+static u32 xeth_mux_sbtxb_hash(struct xeth_sbtxb *sbtxb)
+{
+	struct xeth_msg_header *msg = xeth_sbtxb_data(sbtxb);
+
+	return jhash(sbtxb->key, sbtxb->keylen, msg->kind);
+}
+
+static bool xeth_mux_sbtxb_same_key(struct xeth_sbtxb *a,
+				    struct xeth_sbtxb *b)
+{
+	struct xeth_msg_header *amsg = xeth_sbtxb_data(a);
+	struct xeth_msg_header *bmsg = xeth_sbtxb_data(b);
+
+	return amsg->kind == bmsg->kind && a->keylen == b->keylen &&
+		!memcmp(a->key, b->key, a->keylen);
+}
+
+/* call with sb lock held */
+static bool xeth_mux_sbtxb_replaces(struct xeth_mux_priv *priv,
+				    struct xeth_sbtxb *old,
+				    struct xeth_sbtxb *sbtxb)
+{
+	return !sbtxb->pinned && !old->pinned && !old->sent &&
+		old->gen == priv->sb.gen && old->seq > sbtxb->after &&
+		old->sz >= sbtxb->len && old->to == sbtxb->to &&
+		old->client == sbtxb->client;
+}
+
+/* call with sb lock held; return the sequence number of the unsent message
+ * of the same key that @sbtxb replaced in place, otherwise 0 after indexing
+ * @sbtxb as the latest of its key.
+ */
+static u64 xeth_mux_supersede_sbtxb(struct xeth_mux_priv *priv,
+				    struct xeth_sbtxb *sbtxb)
+{
+	struct net_device *mux = priv->nd;
+	struct xeth_sbtxb *old;
+	u32 hash = xeth_mux_sbtxb_hash(sbtxb);
+
+	hash_for_each_possible(priv->sb.keyed, old, node, hash)
+		if (xeth_mux_sbtxb_same_key(old, sbtxb)) {
+			if (xeth_mux_sbtxb_replaces(priv, old, sbtxb)) {
+				memcpy(xeth_sbtxb_data(old),
+				       xeth_sbtxb_data(sbtxb), sbtxb->len);
+				old->len = sbtxb->len;
+				list_add_tail(&sbtxb->list, &priv->sb.free);
+				xeth_mux_inc_sbtx_free(mux);
+				xeth_mux_inc_sbtx_superseded(mux);
+				return old->seq;
+			}
+			hash_del(&old->node);
+			break;
+		}
+	hash_add(priv->sb.keyed, &sbtxb->node, hash);
+	return 0;
+}
+
+static void xeth_mux_count_backlog(struct net_device *mux, u64 backlog)
+{
+	if (backlog < 16)
+		xeth_mux_inc_sbtx_backlog_lt_16(mux);
+	else if (backlog < 256)
+		xeth_mux_inc_sbtx_backlog_lt_256(mux);
+	else if (backlog < 4096)
+		xeth_mux_inc_sbtx_backlog_lt_4k(mux);
+	else
+		xeth_mux_inc_sbtx_backlog_ge_4k(mux);
+	if (backlog > xeth_mux_get_sbtx_backlog_peak(mux))
+		xeth_mux_set_sbtx_backlog_peak(mux, backlog);
+}
+
+/* call with sb lock held; return the unsent messages of a client from
+ * @first, not counting those of the last dump, which are replayed far
+ * faster than any client can take them
+ */
+static u64 xeth_mux_backlog(struct xeth_mux_priv *priv,
+			    struct xeth_sbtxb *first)
+{
+	if (first->seq < priv->sb.dump_from)
+		return priv->sb.seq - first->seq;
+	if (priv->sb.dump_to == U64_MAX)
+		return 0;
+	return priv->sb.seq - max(first->seq, priv->sb.dump_to);
+}
+
+/**
+ * xeth_mux_check_backlog() - drop the clients that are too far behind
+ *
+ * A stalled controller would otherwise pin every message logged since in
+ * memory. Notifiers can't wait on it, so the client instead loses its
+ * backlog and is closed; it has to resync or dump on reconnect. A dump is
+ * exempt, since a client dropped while taking one would just dump again;
+ * its backlog counts from the dump's end. The deepest backlog of each call
+ * is sampled to the histogram counters.
+ *
+ * call with sb lock held
+ */
+static void xeth_mux_check_backlog(struct xeth_mux_priv *priv)
+{
+	struct net_device *mux = priv->nd;
+	struct xeth_mux_client *client;
+	struct xeth_sbtxb *first;
+	u64 backlog, deepest = 0;
+
+	list_for_each_entry(client, &priv->sb.clients, list) {
+		first = xeth_mux_client_first(client);
+		if (!first)
+			continue;
+		backlog = xeth_mux_backlog(priv, first);
+		if (xeth_mux_highwater && backlog > xeth_mux_highwater) {
+			client->overflow = true;
+			client->synced = false;
+			xeth_mux_client_clear(client);
+			wake_up(&client->wq);
+			xeth_mux_inc_sbtx_overflows(mux);
+			xeth_mux_add_sbtx_dropped(mux, backlog);
+			continue;
+		}
+		if (backlog > deepest)
+			deepest = backlog;
+	}
+	xeth_mux_count_backlog(mux, deepest);
+}
+
+/**
+ * xeth_mux_queue_sbtx() - number and log a message
+ *
+ * Log the message for all synced and subscribed clients, or for just the
+ * requester of the dump that queued it; before a client has resync'd or
+ * requested a dump, the log is only its journal.
+ *
+ * A keyed message replaces one of the same key that no client has sent.
+ * The replacement keeps its predecessor's place and sequence number, so a
+ * burst of changes to an object costs one message and the log stays in
+ * sequence order. Since that moves the new content ahead of everything
+ * logged since, it's skipped when the predecessor was logged before a
+ * barrier, is numbered at or before the message's @after dependency, or
+ * either is pinned.
+ *
+ * Return: the message sequence number.
+ */
+u64 xeth_mux_queue_sbtx(struct net_device *mux, struct xeth_sbtxb *sbtxb)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+	struct xeth_mux_client *client;
+	enum xeth_mux_sb_class class;
+	u64 seq;
+
+	/* genl listeners get every message, superseded or not, but those of
+	 * a client's dump; those of their own dump aren't logged
+	 */
+	if (sbtxb->to != xeth_sbtxb_to_client)
+		xeth_genl_event(mux, xeth_sbtxb_data(sbtxb), sbtxb->len);
+	xeth_mux_lock_sb(priv);
+	if (sbtxb->to == xeth_sbtxb_to_genl) {
+		list_add_tail(&sbtxb->list, &priv->sb.free);
+		xeth_mux_inc_sbtx_free(mux);
+		xeth_mux_unlock_sb(priv);
+		return 0;
+	}
+	if (sbtxb->keylen) {
+		seq = xeth_mux_supersede_sbtxb(priv, sbtxb);
+		if (seq) {
+			xeth_mux_unlock_sb(priv);
+			return seq;
+		}
+	}
+	seq = priv->sb.seq++;
+	sbtxb->seq = seq;
+	sbtxb->gen = priv->sb.gen;
+	if (sbtxb->barrier)
+		priv->sb.gen++;
+	list_add_tail(&sbtxb->list, &priv->sb.log);
+	xeth_mux_inc_sbtx_queued(mux);
+	class = xeth_mux_sbtxb_class(sbtxb);
+	list_for_each_entry(client, &priv->sb.clients, list)
+		if (client->synced && !client->next[class] &&
+		    xeth_mux_client_wants(client, sbtxb)) {
+			client->next[class] = sbtxb;
+			wake_up(&client->wq);
+		}
+	xeth_mux_check_backlog(priv);
+	xeth_mux_trim_log(priv);
 	xeth_mux_unlock_sb(priv);
-	return sbtxb;
+	return seq;
 }
 
-static void xeth_mux_free_sbtxb(struct net_device *mux,
-				struct xeth_sbtxb *sbtxb)
+/**
+ * xeth_mux_update_caps() - agree the encodings of all synced clients
+ *
+ * Messages are encoded once for all clients, so only the capabilities
+ * shared by the synced clients are in effect. Those in effect are kept
+ * while no client is synced to encode the journal of the next session.
+ *
+ * call with sb lock held
+ */
+static void xeth_mux_update_caps(struct xeth_mux_priv *priv)
+{
+	struct xeth_mux_client *client;
+	u64 caps = xeth_mux_kernel_caps;
+	bool synced = false;
+
+	list_for_each_entry(client, &priv->sb.clients, list)
+		if (client->synced) {
+			caps &= client->caps;
+			synced = true;
+		}
+	if (!synced)
+		return;
+	WRITE_ONCE(priv->sb.caps, caps);
+}
+
+u64 xeth_mux_caps(struct net_device *mux)
 {
 	struct xeth_mux_priv *priv = netdev_priv(mux);
 
+	return READ_ONCE(priv->sb.caps);
+}
+
+/* Return the caps agreed with @client, none if NULL for the genl family. */
+u64 xeth_mux_client_caps(struct xeth_mux_client *client)
+{
+	struct xeth_mux_priv *priv;
+	u64 caps;
+
+	if (!client)
+		return 0;
+	priv = netdev_priv(client->mux);
 	xeth_mux_lock_sb(priv);
-	list_add_tail(&sbtxb->list, &priv->sb.free);
+	caps = client->caps;
 	xeth_mux_unlock_sb(priv);
-	xeth_mux_inc_sbtx_free(mux);
+	return caps;
 }
 
-void xeth_mux_queue_sbtx(struct net_device *mux, struct xeth_sbtxb *sbtxb)
+/* call with sb lock held; return true if no message after @seq was encoded
+ * with a capability that the client lacks
+ */
+static bool xeth_mux_client_can_replay(struct xeth_mux_priv *priv,
+				       struct xeth_mux_client *client,
+				       u64 seq)
 {
-	if (xeth_mux_has_sb_connection(mux))
-		xeth_mux_append_sbtxb(mux, sbtxb);
-	else
-		xeth_mux_free_sbtxb(mux, sbtxb);
+	struct xeth_sbtxb *sbtxb;
+
+	list_for_each_entry(sbtxb, &priv->sb.log, list)
+		if (sbtxb->seq > seq && xeth_mux_sbtxb_is_for(sbtxb, client) &&
+		    (xeth_mux_sbtxb_caps(sbtxb) & ~client->caps))
+			return false;
+	return true;
 }
 
-static int xeth_mux_sbtx(struct net_device *mux, struct xeth_sbtxb *sbtxb)
+/* Legacy controllers go straight to a dump without RESYNC. */
+void xeth_mux_sync(struct xeth_mux_client *client)
 {
+	struct xeth_mux_priv *priv;
+
+	if (!client)
+		return;
+	priv = netdev_priv(client->mux);
+	xeth_mux_lock_sb(priv);
+	client->synced = true;
+	xeth_mux_update_caps(priv);
+	xeth_mux_unlock_sb(priv);
+}
+
+/**
+ * xeth_mux_hello() - note what the controller understands
+ *
+ * Controllers should say HELLO before anything else.
+ */
+void xeth_mux_hello(struct xeth_mux_client *client, u64 kinds, u64 caps)
+{
+	struct xeth_mux_priv *priv = netdev_priv(client->mux);
+
+	xeth_mux_lock_sb(priv);
+	client->known = kinds;
+	client->caps = caps & xeth_mux_kernel_caps;
+	client->hello = true;
+	if (client->synced)
+		xeth_mux_update_caps(priv);
+	xeth_mux_unlock_sb(priv);
+	wake_up(&client->wq);
+}
+
+/**
+ * xeth_mux_resync() - replay logged messages after @seq
+ *
+ * Answer with the sequence number of the next message sent; if that isn't
+ * @seq + 1, the journal no longer covers the gap and the controller must
+ * request a full dump.
+ *
+ * Since control messages overtake bulk, @seq is the controller's low-water
+ * mark, the last before its first missing message, so the replay may repeat
+ * some control messages.
+ */
+void xeth_mux_resync(struct xeth_mux_client *client, u64 seq, u64 epoch)
+{
+	struct net_device *mux = client->mux;
 	struct xeth_mux_priv *priv = netdev_priv(mux);
+	struct xeth_sbtxb *sbtxb;
+	enum xeth_mux_sb_class class;
+	bool replay;
+
+	xeth_mux_lock_sb(priv);
+	if (client->synced) {
+		xeth_mux_unlock_sb(priv);
+		xeth_mux_inc_sbrx_invalid(mux);
+		return;
+	}
+	client->synced = true;
+	xeth_mux_update_caps(priv);
+	replay = seq && epoch == priv->sb.epoch && seq < priv->sb.seq &&
+		priv->sb.trimmed <= seq &&
+		xeth_mux_client_can_replay(priv, client, seq);
+	client->ackseq = replay ? seq + 1 : priv->sb.seq;
+	xeth_mux_client_clear(client);
+	if (replay)
+		list_for_each_entry(sbtxb, &priv->sb.log, list)
+			if (sbtxb->seq > seq &&
+			    xeth_mux_client_wants(client, sbtxb)) {
+				class = xeth_mux_sbtxb_class(sbtxb);
+				if (!client->next[class])
+					client->next[class] = sbtxb;
+				xeth_mux_inc_sbtx_replayed(mux);
+			}
+	client->sequenced = true;
+	xeth_mux_unlock_sb(priv);
+	wake_up(&client->wq);
+}
+
+/* Controllers should subscribe before RESYNC or a dump request. */
+void xeth_mux_subscribe(struct xeth_mux_client *client, u64 kinds)
+{
+	struct xeth_mux_priv *priv = netdev_priv(client->mux);
+	int class;
+
+	xeth_mux_lock_sb(priv);
+	client->kinds = kinds;
+	for (class = 0; class < xeth_mux_sb_classes; class++)
+		if (client->next[class])
+			xeth_mux_client_seek(priv, client, class,
+					     client->next[class]);
+	xeth_mux_unlock_sb(priv);
+}
+
+static int xeth_mux_client_send(struct xeth_mux_client *client,
+				void *data, size_t len)
+{
 	struct kvec iov = {
-		.iov_base = xeth_sbtxb_data(sbtxb),
-		.iov_len  = sbtxb->len,
+		.iov_base = data,
+		.iov_len  = len,
 	};
 	struct msghdr msg = {
 		.msg_flags = MSG_DONTWAIT,
 	};
+
+	if (client->ring)
+		return xeth_ring_send(client->ring, data, len);
+	return kernel_sendmsg(client->conn, &msg, &iov, 1, iov.iov_len);
+}
+
+static int xeth_mux_client_sbtx_hello(struct xeth_mux_client *client)
+{
+	struct xeth_msg_hello msg;
+
+	xeth_msg_init(&msg, XETH_MSG_KIND_HELLO);
+	msg.kinds = GENMASK_ULL(XETH_MSG_KIND_QSFP, 0);
+	msg.caps = READ_ONCE(client->caps);
+	return xeth_mux_client_send(client, &msg, sizeof(msg));
+}
+
+/* Tell a sequenced controller where the numbering resumes after a gap. */
+static int xeth_mux_client_sbtx_seq(struct xeth_mux_client *client, u64 seq)
+{
+	struct xeth_mux_priv *priv = netdev_priv(client->mux);
+	struct xeth_msg_seq msg;
 	int n;
 
-	n = kernel_sendmsg(priv->sb.conn, &msg, &iov, 1, iov.iov_len);
+	xeth_msg_init(&msg, XETH_MSG_KIND_SEQ);
+	msg.seq = seq;
+	msg.epoch = priv->sb.epoch;
+	n = xeth_mux_client_send(client, &msg, sizeof(msg));
+	if (n > 0)
+		client->txseq = seq;
+	return n;
+}
+
+/* Send the client's next control, or else bulk, message from a copy so that
+ * the log entry may be superseded or trimmed meanwhile.
+ * return -ENODATA if caught up, -EAGAIN if busy, -ENOBUFS if dropped,
+ * 1 if closed, or 0 if sent
+ */
+static int xeth_mux_client_sbtx(struct xeth_mux_client *client)
+{
+	struct net_device *mux = client->mux;
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+	struct xeth_sbtxb *sbtxb = NULL;
+	enum xeth_mux_sb_class class = xeth_mux_sb_ctl;
+	size_t len = 0;
+	u64 ackseq, seq = 0;
+	bool hello;
+	int n = 1;
+
+	xeth_mux_lock_sb(priv);
+	if (client->overflow) {
+		xeth_mux_unlock_sb(priv);
+		return -ENOBUFS;
+	}
+	hello = client->hello;
+	ackseq = hello ? 0 : client->ackseq;
+	if (!hello && !ackseq) {
+		class = xeth_mux_client_next_class(client);
+		sbtxb = client->next[class];
+	}
+	if (sbtxb) {
+		seq = sbtxb->seq;
+		len = sbtxb->len;
+		memcpy(client->txb, xeth_sbtxb_data(sbtxb), len);
+		sbtxb->sent = true;
+	}
+	xeth_mux_unlock_sb(priv);
+
+	if (hello) {
+		n = xeth_mux_client_sbtx_hello(client);
+		if (n > 0) {
+			xeth_mux_lock_sb(priv);
+			client->hello = false;
+			xeth_mux_unlock_sb(priv);
+		}
+	} else if (ackseq) {
+		n = xeth_mux_client_sbtx_seq(client, ackseq);
+		if (n > 0) {
+			xeth_mux_lock_sb(priv);
+			client->ackseq = 0;
+			xeth_mux_unlock_sb(priv);
+		}
+	} else if (!sbtxb)
+		return -ENODATA;
+	else {
+		if (client->sequenced && seq != client->txseq)
+			n = xeth_mux_client_sbtx_seq(client, seq);
+		if (n > 0)
+			n = xeth_mux_client_send(client, client->txb, len);
+		if (n > 0) {
+			client->txseq = seq + 1;
+			xeth_mux_lock_sb(priv);
+			if (client->next[class] == sbtxb &&
+			    sbtxb->seq == seq)
+				xeth_mux_client_seek(priv, client, class,
+						     list_next_entry(sbtxb,
+								     list));
+			xeth_mux_trim_log(priv);
+			xeth_mux_unlock_sb(priv);
+		}
+	}
 	if (n == -EAGAIN) {
-		xeth_mux_prepend_sbtxb(mux, sbtxb);
 		xeth_mux_inc_sbtx_retries(mux);
 		return n;
 	}
-	xeth_mux_free_sbtxb(mux, sbtxb);
 	if (n > 0) {
 		xeth_mux_inc_sbtx_msgs(mux);
 		return 0;
@@ -758,68 +1782,222 @@ static int xeth_mux_sbtx(struct net_device *mux, struct xeth_sbtxb *sbtxb)
 	return n < 0 ? n : 1; /* 1 indicates EOF */
 }
 
-static int xeth_mux_service_sbtx(struct net_device *mux)
+static bool xeth_mux_client_is_ready(struct xeth_mux_client *client)
 {
-	struct xeth_mux_priv *priv = netdev_priv(mux);
+	return READ_ONCE(client->next[xeth_mux_sb_ctl]) ||
+		READ_ONCE(client->next[xeth_mux_sb_bulk]) ||
+		READ_ONCE(client->ackseq) || READ_ONCE(client->hello) ||
+		READ_ONCE(client->overflow) ||
+		READ_ONCE(client->done);
+}
+
+static int xeth_mux_client_service_sbtx(struct xeth_mux_client *client)
+{
+	struct net_device *mux = client->mux;
 	const unsigned int maxms = 320;
 	const unsigned int minms = 10;
-	unsigned int ms = minms;
 	int err = 0;
-	struct xeth_sbtxb *sbtxb, *tmp;
 
-	while (!err && xeth_mux_has_sbrx_task(mux) &&
-	       !kthread_should_stop() && !signal_pending(current)) {
+	while (!err && !READ_ONCE(client->done) && !kthread_should_stop()) {
 		xeth_mux_inc_sbtx_ticks(mux);
-		sbtxb = xeth_mux_pop_sbtxb(mux);
-		if (sbtxb) {
-			ms = minms;
-			err = xeth_mux_sbtx(mux, sbtxb);
-			if (err == -EAGAIN) {
-				err = 0;
-				msleep(ms);
-			}
-		} else {
-			msleep(ms);
-			if (ms < maxms)
-				ms *= 2;
+		err = xeth_mux_client_sbtx(client);
+		if (err == -EAGAIN) {
+			err = 0;
+			msleep(minms);
+		} else if (err == -ENODATA) {
+			err = 0;
+			wait_event_interruptible_timeout(client->wq,
+				xeth_mux_client_is_ready(client),
+				msecs_to_jiffies(maxms));
 		}
 	}
+	return err;
+}
+
+static int xeth_mux_client_service_sbrx(void *data)
+{
+	struct xeth_mux_client *client = data;
+	struct timeval tv = {
+		.tv_sec = 0,
+		.tv_usec = 10000,
+	};
+	int err = 0;
+
+	if (client->conn)
+		err = kernel_setsockopt(client->conn, SOL_SOCKET,
+					SO_RCVTIMEO_NEW, (char *)&tv,
+					sizeof(tv));
+	while (!err && !kthread_should_stop())
+		err = client->ring ?
+			xeth_sbrx_ring(client->mux, client, client->ring,
+				       client->rxb) :
+			xeth_sbrx(client->mux, client, client->conn,
+				  client->rxb);
+	WRITE_ONCE(client->done, true);
+	wake_up(&client->wq);
+	return err;
+}
+
+static void xeth_mux_free_client(struct xeth_mux_client *client)
+{
+	if (client->conn)
+		sock_release(client->conn);
+	if (client->ring) {
+		xeth_ring_hangup(client->ring);
+		xeth_ring_put(client->ring);
+	}
+	kfree(client->fib_filter);
+	kfree(client->txb);
+	kfree(client->rxb);
+	kfree(client);
+}
+
+static void xeth_mux_del_client(struct xeth_mux_client *client)
+{
+	struct net_device *mux = client->mux;
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+	bool last;
 
+	mutex_lock(&priv->sb.session);
 	xeth_mux_lock_sb(priv);
-	list_for_each_entry_safe(sbtxb, tmp, &priv->sb.tx, list) {
-		list_del(&sbtxb->list);
-		xeth_mux_dec_sbtx_queued(mux);
-		list_add_tail(&sbtxb->list, &priv->sb.free);
-		xeth_mux_inc_sbtx_free(mux);
+	list_del(&client->list);
+	xeth_mux_update_caps(priv);
+	xeth_mux_client_clear(client);
+	xeth_mux_trim_log(priv);
+	last = list_empty(&priv->sb.clients);
+	xeth_mux_unlock_sb(priv);
+	if (last) {
+		xeth_mux_end_session(mux);
+		/* with a journal, keep notifying for a resync by the next
+		 * session
+		 */
+		if (!xeth_mux_journal)
+			xeth_mux_stop_notifiers(mux);
+		xeth_mux_clear_sb_connection(mux);
 	}
+	mutex_unlock(&priv->sb.session);
+	xeth_nb_update_fib_filter(mux);
+	xeth_mux_free_client(client);
+	xeth_mux_lock_sb(priv);
+	xeth_mux_dec_sb_clients(mux);
+	wake_up(&priv->sb.wq);
 	xeth_mux_unlock_sb(priv);
-	xeth_debug_err(xeth_mux_get_sbtx_queued(mux) > 0);
+}
 
+static int xeth_mux_client_main(void *data)
+{
+	struct xeth_mux_client *client = data;
+	int err;
+
+	err = xeth_mux_client_service_sbtx(client);
+	WRITE_ONCE(client->done, true);
+	kthread_stop(client->rx);
+	put_task_struct(client->rx);
+	xeth_mux_del_client(client);
 	return err;
 }
 
+/* The first client ends any restart hold; the last begins one. The client
+ * owns @conn, or a reference to @ring.
+ */
+static int xeth_mux_add_client(struct net_device *mux, struct socket *conn,
+			       struct xeth_ring *ring)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+	struct xeth_mux_client *client;
+	struct task_struct *t;
+
+	client = kzalloc(sizeof(*client), GFP_KERNEL);
+	if (!client) {
+		if (conn)
+			sock_release(conn);
+		return -ENOMEM;
+	}
+	client->mux = mux;
+	client->conn = conn;
+	client->ring = ring ? xeth_ring_get(ring) : NULL;
+	client->kinds = ~0ULL;
+	client->known = ~0ULL;
+	init_waitqueue_head(&client->wq);
+	client->rxb = kzalloc(XETH_SIZEOF_JUMBO_FRAME, GFP_KERNEL);
+	client->txb = kzalloc(XETH_SIZEOF_JUMBO_FRAME, GFP_KERNEL);
+	if (!client->rxb || !client->txb) {
+		xeth_mux_free_client(client);
+		return -ENOMEM;
+	}
+
+	mutex_lock(&priv->sb.session);
+	xeth_mux_lock_sb(priv);
+	client->id = priv->sb.ids++;
+	list_add_tail(&client->list, &priv->sb.clients);
+	xeth_mux_unlock_sb(priv);
+	xeth_mux_inc_sb_connections(mux);
+	xeth_mux_inc_sb_clients(mux);
+	if (!xeth_mux_has_sb_connection(mux)) {
+		xeth_mux_set_sb_connection(mux);
+		xeth_mux_start_session(mux);
+	}
+	mutex_unlock(&priv->sb.session);
+	/* until it says otherwise, the client takes every route */
+	xeth_nb_update_fib_filter(mux);
+
+	t = kthread_run(xeth_mux_client_service_sbrx, client, "%s-rx%u",
+			mux->name, client->id);
+	if (IS_ERR(t)) {
+		xeth_mux_del_client(client);
+		return PTR_ERR(t);
+	}
+	get_task_struct(t);
+	client->rx = t;
+
+	t = kthread_run(xeth_mux_client_main, client, "%s-tx%u",
+			mux->name, client->id);
+	if (IS_ERR(t)) {
+		kthread_stop(client->rx);
+		put_task_struct(client->rx);
+		xeth_mux_del_client(client);
+		return PTR_ERR(t);
+	}
+	return 0;
+}
+
+/* A client by a ring of the mux character device. */
+int xeth_mux_add_ring(struct net_device *mux, struct xeth_ring *ring)
+{
+	return xeth_mux_add_client(mux, NULL, ring);
+}
+
+static void xeth_mux_stop_clients(struct net_device *mux)
+{
+	struct xeth_mux_priv *priv = netdev_priv(mux);
+	struct xeth_mux_client *client;
+
+	xeth_mux_lock_sb(priv);
+	list_for_each_entry(client, &priv->sb.clients, list) {
+		WRITE_ONCE(client->done, true);
+		wake_up(&client->wq);
+	}
+	xeth_mux_unlock_sb(priv);
+	wait_event(priv->sb.wq, !xeth_mux_get_sb_clients(mux));
+	/* wait for the last client to release the lock after its wake_up */
+	xeth_mux_lock_sb(priv);
+	xeth_mux_unlock_sb(priv);
+}
+
 static int xeth_mux_main(void *data)
 {
 	struct net_device *mux = data;
 	struct xeth_mux_priv *priv = netdev_priv(mux);
 	const int backlog = 3;
-	struct socket *ln = NULL;
+	struct socket *ln = NULL, *conn;
 	struct sockaddr_un addr;
 	char name[TASK_COMM_LEN];
 	int n, err;
 
-	if (!priv->sb.rx) {
-		priv->sb.rx = devm_kzalloc(&mux->dev, XETH_SIZEOF_JUMBO_FRAME,
-					   GFP_KERNEL);
-		if (!priv->sb.rx)
-			return -ENOMEM;
-	}
-
 	xeth_mux_set_main_task(mux);
 	get_task_comm(name, current);
 	allow_signal(SIGKILL);
 
-	priv->sb.conn = NULL;
 	memset(&addr, 0, sizeof(struct sockaddr_un));
 	addr.sun_family = AF_UNIX;
 	/* Note: This is an abstract namespace w/ addr.sun_path[0] == 0 */
@@ -838,39 +2016,31 @@ static int xeth_mux_main(void *data)
 	if (err)
 		goto xeth_mux_main_exit;
 	xeth_mux_clear_sb_connection(mux);
+	/* the socket remains if there's no device for the ring transport */
+	priv->ring = xeth_debug_ptr_err(xeth_ring_register(mux));
 	xeth_mux_set_sb_listen(mux);
 	while(!err && !kthread_should_stop() && !signal_pending(current)) {
-		err = kernel_accept(ln, &priv->sb.conn, O_NONBLOCK);
-		if (err == -EAGAIN) {
+		/* block until connect or the SIGKILL from xeth_mux_uninit() */
+		err = kernel_accept(ln, &conn, 0);
+		if (err == -ERESTARTSYS || err == -EINTR) {
 			err = 0;
-			msleep_interruptible(100);
-			schedule();
 			continue;
 		}
-		if (!err) {
-			struct task_struct *sbrx;
-			xeth_mux_set_sb_connection(mux);
-			sbrx = xeth_mux_fork_sbrx(mux);
-			if (sbrx) {
-				xeth_mux_drop_all_port_carrier(mux);
-				xeth_mux_reset_all_link_stats(mux);
-				xeth_mux_reset_all_port_ethtool_stats(mux);
-				xeth_debug_nd_err(mux,
-						  xeth_mux_service_sbtx(mux));
-				if (xeth_mux_has_sbrx_task(mux)) {
-					kthread_stop(sbrx);
-					while (xeth_mux_has_sbrx_task(mux)) {
-						msleep_interruptible(100);
-						schedule();
-					}
-				}
-				xeth_mux_drop_all_port_carrier(mux);
-			}
-			sock_release(priv->sb.conn);
-			priv->sb.conn = NULL;
-			xeth_mux_clear_sb_connection(mux);
-		}
+		if (!err)
+			xeth_debug_nd_err(mux, xeth_mux_add_client(mux, conn,
+								   NULL));
 	}
+	xeth_ring_unregister(priv->ring);
+	priv->ring = NULL;
+	xeth_mux_stop_clients(mux);
+	cancel_delayed_work_sync(&priv->hold);
+	xeth_mux_clear_sb_hold(mux);
+	xeth_mux_clear_sb_reconcile(mux);
+	xeth_mux_stop_notifiers(mux);
+	/* with no clients left, this frees the filter */
+	xeth_nb_update_fib_filter(mux);
+	xeth_nh_flush(mux);
+	xeth_neigh_flush(mux);
 	rcu_barrier();
 	xeth_mux_clear_sb_listen(mux);
 xeth_mux_main_exit:
@@ -888,6 +2058,8 @@ static void xeth_mux_uninit(struct net_device *mux)
 	int i;
 
 	if (xeth_mux_has_main_task(mux)) {
+		/* interrupt the blocking accept */
+		send_sig(SIGKILL, priv->main, 1);
 		kthread_stop(priv->main);
 		priv->main = NULL;
 		while (xeth_mux_has_main_task(mux)) ;
@@ -1065,7 +2237,7 @@ netdev_tx_t xeth_mux_encap_xmit(struct sk_buff *skb, struct net_device *nd)
 		/* FIXME vpls */
 		break;
 	}
-	xeth_inc_TX_DROPPED(proxy->link_stats);
+	atomic64_inc(&proxy->tx_dropped);
 	kfree_skb(skb);
 	return NETDEV_TX_OK;
 }
@@ -1479,23 +2651,30 @@ static size_t xeth_mux_flags_prop(struct platform_device *pd,
 	return n;
 }
 
-static size_t xeth_mux_stats_prop(struct platform_device *pd,
-				  char names[][ETH_GSTRING_LEN])
+static void xeth_mux_stats_prop(struct platform_device *pd,
+				struct xeth_mux_priv *priv)
 {
 	static const char *val[xeth_mux_max_stats];
+	char (*names)[ETH_GSTRING_LEN];
 	ssize_t n;
 	int i;
 
 	n = device_property_read_string_array(&pd->dev, "stats", NULL, 0);
 	if (n <= 0)
-		return 0;
+		return;
 	if (n > xeth_mux_max_stats)
 		n = xeth_mux_max_stats;
 	if (device_property_read_string_array(&pd->dev, "stats", val, n) != n)
-		return 0;
+		return;
+	names = kcalloc(n, ETH_GSTRING_LEN, GFP_KERNEL);
+	if (!names)
+		return;
 	for (i = 0; i < n; i++)
 		strncpy(names[i], val[i], ETH_GSTRING_LEN);
-	return n;
+	xeth_mux_lock_stat_name(priv);
+	xeth_debug_err(xeth_mux_publish_stat_names(priv, 0, names[0], n));
+	xeth_mux_unlock_stat_name(priv);
+	kfree(names);
 }
 
 static void xeth_mux_qsfp_i2c_addrs_prop(struct platform_device *pd, u16 *addrs)
@@ -1624,8 +2803,7 @@ static int xeth_mux_probe(struct platform_device *pd)
 	priv->ports = xeth_mux_ports_prop(pd);
 	priv->priv_flags.named =
 		xeth_mux_flags_prop(pd, priv->priv_flags.names);
-	priv->stat_name.named =
-		xeth_mux_stats_prop(pd, priv->stat_name.names);
+	xeth_mux_stats_prop(pd, priv);
 	xeth_mux_qsfp_i2c_addrs_prop(pd, priv->qsfp_i2c_addrs);
 
 	if (n_links > 0)
@@ -1644,7 +2822,7 @@ static int xeth_mux_probe(struct platform_device *pd)
 		return err;
 	}
 
-	if (!priv->stat_name.named) {
+	if (!xeth_mux_n_stats(mux)) {
 		err = device_create_file(&mux->dev, &xeth_mux_stat_name_attr);
 		if (!err)
 			priv->stat_name.sysfs = true;
@@ -20,6 +20,9 @@ enum {
 	xeth_mux_max_stats = 512,
 };
 
+struct xeth_mux_client;
+struct xeth_ring;
+
 extern struct platform_driver xeth_mux_driver;
 extern struct rtnl_link_ops xeth_mux_lnko;
 extern const struct net_device_ops xeth_mux_ndo;
@@ -39,7 +42,7 @@ size_t xeth_mux_n_priv_flags(struct net_device *mux);
 void xeth_mux_priv_flag_names(struct net_device *mux, char *buf);
 
 size_t xeth_mux_n_stats(struct net_device *mux);
-void xeth_mux_stat_names(struct net_device *mux, char *buf);
+size_t xeth_mux_stat_names(struct net_device *mux, char *buf, size_t max);
 
 atomic64_t *xeth_mux_counters(struct net_device *mux);
 volatile unsigned long *xeth_mux_flags(struct net_device *mux);
@@ -50,6 +53,12 @@ void xeth_mux_check_lower_carrier(struct net_device *mux);
 void xeth_mux_del_vlans(struct net_device *mux, struct net_device *nd,
 			struct list_head *unregq);
 void xeth_mux_dump_all_ifinfo(struct net_device *);
+void xeth_mux_dump_all_netns(struct net_device *);
+void xeth_mux_lock_dump(struct net_device *mux, struct xeth_mux_client *);
+void xeth_mux_unlock_dump(struct net_device *mux);
+u32 xeth_mux_dumping(struct net_device *mux);
+int xeth_mux_add_ring(struct net_device *mux, struct xeth_ring *);
+u64 xeth_mux_caps(struct net_device *mux);
 
 const unsigned short *xeth_mux_qsfp_i2c_addrs(struct net_device *mux);
 struct gpio_desc *xeth_mux_qsfp_absent_gpio(struct net_device *mux, size_t prt);
@@ -63,6 +72,7 @@ enum xeth_mux_counter {
 	xeth_mux_counter_ex_frames,
 	xeth_mux_counter_ex_bytes,
 	xeth_mux_counter_sb_connections,
+	xeth_mux_counter_sb_clients,
 	xeth_mux_counter_sbex_invalid,
 	xeth_mux_counter_sbex_dropped,
 	xeth_mux_counter_sbrx_invalid,
@@ -76,6 +86,16 @@ enum xeth_mux_counter {
 	xeth_mux_counter_sbtx_queued,
 	xeth_mux_counter_sbtx_free,
 	xeth_mux_counter_sbtx_ticks,
+	xeth_mux_counter_sbtx_replayed,
+	xeth_mux_counter_sbtx_superseded,
+	xeth_mux_counter_sbtx_unchanged,
+	xeth_mux_counter_sbtx_backlog_lt_16,
+	xeth_mux_counter_sbtx_backlog_lt_256,
+	xeth_mux_counter_sbtx_backlog_lt_4k,
+	xeth_mux_counter_sbtx_backlog_ge_4k,
+	xeth_mux_counter_sbtx_backlog_peak,
+	xeth_mux_counter_sbtx_overflows,
+	xeth_mux_counter_sbtx_dropped,
 	xeth_mux_n_counters,
 };
 
@@ -85,6 +105,7 @@ enum xeth_mux_counter {
 	xeth_mux_counter_name(ex_frames),				\
 	xeth_mux_counter_name(ex_bytes),				\
 	xeth_mux_counter_name(sb_connections),				\
+	xeth_mux_counter_name(sb_clients),				\
 	xeth_mux_counter_name(sbex_invalid),				\
 	xeth_mux_counter_name(sbex_dropped),				\
 	xeth_mux_counter_name(sbrx_invalid),				\
@@ -98,6 +119,16 @@ enum xeth_mux_counter {
 	xeth_mux_counter_name(sbtx_queued),				\
 	xeth_mux_counter_name(sbtx_free),				\
 	xeth_mux_counter_name(sbtx_ticks),				\
+	xeth_mux_counter_name(sbtx_replayed),				\
+	xeth_mux_counter_name(sbtx_superseded),				\
+	xeth_mux_counter_name(sbtx_unchanged),				\
+	xeth_mux_counter_name(sbtx_backlog_lt_16),			\
+	xeth_mux_counter_name(sbtx_backlog_lt_256),			\
+	xeth_mux_counter_name(sbtx_backlog_lt_4k),			\
+	xeth_mux_counter_name(sbtx_backlog_ge_4k),			\
+	xeth_mux_counter_name(sbtx_backlog_peak),			\
+	xeth_mux_counter_name(sbtx_overflows),				\
+	xeth_mux_counter_name(sbtx_dropped),				\
 	[xeth_mux_n_counters] = NULL
 
 static inline void xeth_mux_counter_init(atomic64_t *t)
@@ -162,6 +193,7 @@ xeth_mux_set_##name(struct net_device *mux, s64 n)			\
 xeth_mux_counter_ops(ex_frames)
 xeth_mux_counter_ops(ex_bytes)
 xeth_mux_counter_ops(sb_connections)
+xeth_mux_counter_ops(sb_clients)
 xeth_mux_counter_ops(sbex_invalid)
 xeth_mux_counter_ops(sbex_dropped)
 xeth_mux_counter_ops(sbrx_invalid)
@@ -175,17 +207,28 @@ xeth_mux_counter_ops(sbtx_no_mem)
 xeth_mux_counter_ops(sbtx_queued)
 xeth_mux_counter_ops(sbtx_free)
 xeth_mux_counter_ops(sbtx_ticks)
+xeth_mux_counter_ops(sbtx_replayed)
+xeth_mux_counter_ops(sbtx_superseded)
+xeth_mux_counter_ops(sbtx_unchanged)
+xeth_mux_counter_ops(sbtx_backlog_lt_16)
+xeth_mux_counter_ops(sbtx_backlog_lt_256)
+xeth_mux_counter_ops(sbtx_backlog_lt_4k)
+xeth_mux_counter_ops(sbtx_backlog_ge_4k)
+xeth_mux_counter_ops(sbtx_backlog_peak)
+xeth_mux_counter_ops(sbtx_overflows)
+xeth_mux_counter_ops(sbtx_dropped)
 
 enum xeth_mux_flag {
 	xeth_mux_flag_main_task,
 	xeth_mux_flag_sb_listen,
 	xeth_mux_flag_sb_connection,
-	xeth_mux_flag_sbrx_task,
 	xeth_mux_flag_fib_notifier,
 	xeth_mux_flag_inetaddr_notifier,
 	xeth_mux_flag_inet6addr_notifier,
 	xeth_mux_flag_netdevice_notifier,
 	xeth_mux_flag_netevent_notifier,
+	xeth_mux_flag_sb_hold,
+	xeth_mux_flag_sb_reconcile,
 	xeth_mux_n_flags,
 };
 
@@ -195,12 +238,13 @@ enum xeth_mux_flag {
 	xeth_mux_flag_name(main_task),					\
 	xeth_mux_flag_name(sb_listen),					\
 	xeth_mux_flag_name(sb_connection),				\
-	xeth_mux_flag_name(sbrx_task),					\
 	xeth_mux_flag_name(fib_notifier),				\
 	xeth_mux_flag_name(inetaddr_notifier),				\
 	xeth_mux_flag_name(inet6addr_notifier),				\
 	xeth_mux_flag_name(netdevice_notifier),				\
 	xeth_mux_flag_name(netevent_notifier),				\
+	xeth_mux_flag_name(sb_hold),					\
+	xeth_mux_flag_name(sb_reconcile),				\
 	[xeth_mux_n_flags] = NULL,
 
 #define xeth_mux_flag_ops(name)						\
@@ -240,11 +284,12 @@ static inline void xeth_mux_set_##name(struct net_device *mux)		\
 xeth_mux_flag_ops(main_task)
 xeth_mux_flag_ops(sb_listen)
 xeth_mux_flag_ops(sb_connection)
-xeth_mux_flag_ops(sbrx_task)
 xeth_mux_flag_ops(fib_notifier)
 xeth_mux_flag_ops(inetaddr_notifier)
 xeth_mux_flag_ops(inet6addr_notifier)
 xeth_mux_flag_ops(netdevice_notifier)
 xeth_mux_flag_ops(netevent_notifier)
+xeth_mux_flag_ops(sb_hold)
+xeth_mux_flag_ops(sb_reconcile)
 
 #endif /* __NET_ETHERNET_XETH_MUX_H */
@@ -10,24 +10,90 @@
  */
 
 #include "xeth_nb.h"
+#include "xeth_fibdump.h"
 #include "xeth_mux.h"
+#include "xeth_nh.h"
 #include "xeth_proxy.h"
 #include "xeth_sbtx.h"
 #include "xeth_debug.h"
 #include <net/ip_fib.h>
 
-static int xeth_nb_fib(struct notifier_block *fib,
-		       unsigned long event, void *ptr)
+void xeth_nb_init(struct xeth_nb *nb)
+{
+	RCU_INIT_POINTER(nb->fib_filter, NULL);
+	mutex_init(&nb->fib_filter_mutex);
+}
+
+static u32 xeth_nb_fib_table(unsigned long event,
+			     struct fib_notifier_info *info)
+{
+	switch (event) {
+	case FIB_EVENT_ENTRY_REPLACE:
+	case FIB_EVENT_ENTRY_APPEND:
+	case FIB_EVENT_ENTRY_ADD:
+	case FIB_EVENT_ENTRY_DEL:
+		if (info->family == AF_INET)
+			return container_of(info,
+					    struct fib_entry_notifier_info,
+					    info)->tb_id;
+		if (info->family == AF_INET6) {
+			struct fib6_entry_notifier_info *feni =
+				container_of(info, typeof(*feni), info);
+			return feni->rt->fib6_table->tb6_id;
+		}
+	}
+	return 0;
+}
+
+/* A @table of 0, as of a nexthop, matches any entry's table. */
+bool xeth_nb_fib_filter_allows(const struct xeth_nb_fib_filter *filter,
+			       u64 net, u32 table, u8 family)
+{
+	const struct xeth_fib_filter_entry *entry;
+	size_t i;
+
+	if (!filter)
+		return true;
+	for (i = 0; i < filter->n; i++) {
+		entry = &filter->entries[i];
+		if ((!entry->net || entry->net == net) &&
+		    (!entry->family || entry->family == family) &&
+		    (!entry->table || !table || entry->table == table))
+			return true;
+	}
+	return false;
+}
+
+/* Deletions always pass since the route may have been sent before the
+ * filter narrowed.
+ */
+static bool xeth_nb_fib_allowed(struct xeth_nb *nb, unsigned long event,
+				struct fib_notifier_info *info)
+{
+	bool allowed;
+
+	if (event == FIB_EVENT_ENTRY_DEL || event == FIB_EVENT_NH_DEL)
+		return true;
+	rcu_read_lock();
+	allowed = xeth_nb_fib_filter_allows(rcu_dereference(nb->fib_filter),
+					    xeth_sbtx_net_inum(info->net),
+					    xeth_nb_fib_table(event, info),
+					    info->family);
+	rcu_read_unlock();
+	return allowed;
+}
+
+static int xeth_nb_fib_event(struct xeth_nb *nb, unsigned long event,
+			     struct fib_notifier_info *info)
 {
-	struct fib_notifier_info *info = ptr;
-	struct xeth_nb *nb;
 	struct net_device *mux;
 
-	if (fib->notifier_call != xeth_nb_fib)
+	if (mux = xeth_mux_of_nb(nb), IS_ERR(mux))
 		return NOTIFY_DONE;
-	if (nb = xeth_debug_container_of(fib, struct xeth_nb, fib), IS_ERR(nb))
+	/* filter before allocating anything for the side-band */
+	if (!xeth_nb_fib_allowed(nb, event, info))
 		return NOTIFY_DONE;
-	if (mux = xeth_mux_of_nb(nb), IS_ERR(mux))
+	if (xeth_fibdump_event(mux, event, info))
 		return NOTIFY_DONE;
 	switch (event) {
 	case FIB_EVENT_ENTRY_REPLACE:
@@ -51,10 +117,16 @@ static int xeth_nb_fib(struct notifier_block *fib,
 			break;
 		}
 		break;
-	case FIB_EVENT_RULE_ADD:
-	case FIB_EVENT_RULE_DEL:
 	case FIB_EVENT_NH_ADD:
 	case FIB_EVENT_NH_DEL:
+		if (info->family == AF_INET) {
+			struct fib_nh_notifier_info *fnni =
+				container_of(info, typeof(*fnni), info);
+			xeth_sbtx_fib_nh(mux, fnni, event);
+		}
+		break;
+	case FIB_EVENT_RULE_ADD:
+	case FIB_EVENT_RULE_DEL:
 	case FIB_EVENT_VIF_ADD:
 	case FIB_EVENT_VIF_DEL:
 		break;
@@ -64,6 +136,39 @@ static int xeth_nb_fib(struct notifier_block *fib,
 	return NOTIFY_DONE;
 }
 
+static int xeth_nb_fib(struct notifier_block *fib,
+		       unsigned long event, void *ptr)
+{
+	struct xeth_nb *nb;
+
+	if (fib->notifier_call != xeth_nb_fib)
+		return NOTIFY_DONE;
+	if (nb = xeth_debug_container_of(fib, struct xeth_nb, fib), IS_ERR(nb))
+		return NOTIFY_DONE;
+	return xeth_nb_fib_event(nb, event, ptr);
+}
+
+/* Only the replay to a dump, by the dumping task, is sent through here;
+ * live events are sent through the other notifier.
+ */
+static int xeth_nb_fib_dump(struct notifier_block *fib_dump,
+			    unsigned long event, void *ptr)
+{
+	struct xeth_nb *nb;
+	struct net_device *mux;
+
+	if (fib_dump->notifier_call != xeth_nb_fib_dump)
+		return NOTIFY_DONE;
+	nb = xeth_debug_container_of(fib_dump, struct xeth_nb, fib_dump);
+	if (IS_ERR(nb))
+		return NOTIFY_DONE;
+	if (mux = xeth_mux_of_nb(nb), IS_ERR(mux))
+		return NOTIFY_DONE;
+	if (!xeth_mux_dumping(mux))
+		return NOTIFY_DONE;
+	return xeth_nb_fib_event(nb, event, ptr);
+}
+
 static int xeth_nb_inetaddr(struct notifier_block *inetaddr,
 			    unsigned long event, void *ptr)
 {
@@ -140,6 +245,7 @@ static int xeth_nb_netdevice(struct notifier_block *netdevice,
 			break;
 		case NETDEV_UNREGISTER:
 			xeth_sbtx_netns(mux, ndnet, false);
+			xeth_nh_flush_net(mux, xeth_sbtx_net_inum(ndnet));
 			break;
 		}
 		return NOTIFY_DONE;
@@ -246,3 +352,41 @@ xeth_nb_stop(inet6addr)
 xeth_nb_stop(netdevice)
 xeth_nb_stop(netevent)
 
+/**
+ * xeth_nb_dump_fib() - replay the FIB to the requester of a dump
+ *
+ * The replay is by a notifier registered just for it, then unregistered,
+ * so the live notifier goes on for the other clients. Call while dumping.
+ */
+int xeth_nb_dump_fib(struct net_device *mux)
+{
+	struct xeth_nb *nb = xeth_mux_nb(mux);
+	int err;
+
+	nb->fib_dump.notifier_call = xeth_nb_fib_dump;
+	err = register_fib_notifier(&nb->fib_dump, NULL);
+	if (!err)
+		unregister_fib_notifier(&nb->fib_dump);
+	return err;
+}
+
+/**
+ * xeth_nb_update_fib_filter() - rebuild the FIB allow-list of the notifier
+ *
+ * Call after a client changes its filter or the kinds it takes, connects,
+ * or disconnects. The mutex keeps an earlier rebuild from replacing a
+ * later one.
+ */
+void xeth_nb_update_fib_filter(struct net_device *mux)
+{
+	struct xeth_nb *nb = xeth_mux_nb(mux);
+	struct xeth_nb_fib_filter *old;
+
+	mutex_lock(&nb->fib_filter_mutex);
+	old = rcu_dereference_protected(nb->fib_filter,
+					lockdep_is_held(&nb->fib_filter_mutex));
+	rcu_assign_pointer(nb->fib_filter, xeth_mux_fib_filter(mux));
+	mutex_unlock(&nb->fib_filter_mutex);
+	if (old)
+		kfree_rcu(old, rcu);
+}
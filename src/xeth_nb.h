@@ -10,18 +10,35 @@
 #ifndef __NET_ETHERNET_XETH_NB_H
 #define __NET_ETHERNET_XETH_NB_H
 
+#include "xeth.h"
 #include <linux/netdevice.h>
 
+struct xeth_nb_fib_filter {
+	struct rcu_head rcu;
+	size_t n;
+	struct xeth_fib_filter_entry entries[];
+};
+
 struct xeth_nb {
 	struct notifier_block fib;
+	/* @fib_dump: registered only to replay the FIB to a dump */
+	struct notifier_block fib_dump;
 	struct notifier_block inetaddr;
 	struct notifier_block inet6addr;
 	struct notifier_block netdevice;
 	struct notifier_block netevent;
+	/* @fib_filter: union of the clients' filters, NULL to allow all;
+	 * @fib_filter_mutex: orders its updates
+	 */
+	struct xeth_nb_fib_filter __rcu *fib_filter;
+	struct mutex fib_filter_mutex;
 };
 
 struct xeth_nb *xeth_mux_nb(struct net_device *mux);
 struct net_device *xeth_mux_of_nb(struct xeth_nb *);
+struct xeth_nb_fib_filter *xeth_mux_fib_filter(struct net_device *mux);
+
+void xeth_nb_init(struct xeth_nb *);
 
 int xeth_nb_start_fib(struct net_device *mux);
 int xeth_nb_start_inetaddr(struct net_device *mux);
@@ -35,4 +52,9 @@ void xeth_nb_stop_inet6addr(struct net_device *mux);
 void xeth_nb_stop_netdevice(struct net_device *mux);
 void xeth_nb_stop_netevent(struct net_device *mux);
 
+int xeth_nb_dump_fib(struct net_device *mux);
+bool xeth_nb_fib_filter_allows(const struct xeth_nb_fib_filter *,
+			       u64 net, u32 table, u8 family);
+void xeth_nb_update_fib_filter(struct net_device *mux);
+
 #endif	/* __NET_ETHERNET_XETH_NB_H */
@@ -0,0 +1,159 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0
+ * Copyright(c) 2018-2020 Platina Systems, Inc.
+ *
+ * Contact Information:
+ * sw@platina.com
+ * Platina Systems, 3180 Del La Cruz Blvd, Santa Clara, CA 95054
+ */
+
+#include "xeth_neigh.h"
+#include "xeth_mux.h"
+#include "xeth_sbtx.h"
+#include "xeth_debug.h"
+#include <linux/etherdevice.h>
+#include <linux/jhash.h>
+
+/* (net, ifindex, family, len, reserved, dst) */
+enum {
+	xeth_neigh_keyoff = offsetof(struct xeth_msg_neigh_update, net),
+	xeth_neigh_keylen = offsetofend(struct xeth_msg_neigh_update, dst) -
+		xeth_neigh_keyoff,
+};
+
+struct xeth_neigh_entry {
+	struct hlist_node node;
+	struct list_head lru;
+	u8 key[xeth_neigh_keylen];
+	/* @lladdr: last sent, zero if invalid */
+	u8 lladdr[ETH_ALEN];
+};
+
+void xeth_neigh_init(struct xeth_neigh *xn)
+{
+	spin_lock_init(&xn->lock);
+	hash_init(xn->ht);
+	INIT_LIST_HEAD(&xn->lru);
+	xn->n = 0;
+}
+
+/* call with lock held */
+static void xeth_neigh_forget(struct xeth_neigh *xn,
+			      struct xeth_neigh_entry *e)
+{
+	hash_del(&e->node);
+	list_del(&e->lru);
+	xn->n--;
+	kfree(e);
+}
+
+/* call with lock held; return true if @msg changes the lladdr or validity
+ * or is of a neighbour that isn't remembered
+ */
+static bool xeth_neigh_changed(struct xeth_neigh *xn,
+			       const struct xeth_msg_neigh_update *msg)
+{
+	const u8 *key = (const u8 *)msg + xeth_neigh_keyoff;
+	struct xeth_neigh_entry *e;
+	u32 hash = jhash(key, xeth_neigh_keylen, 0);
+
+	hash_for_each_possible(xn->ht, e, node, hash)
+		if (!memcmp(e->key, key, xeth_neigh_keylen)) {
+			list_move_tail(&e->lru, &xn->lru);
+			if (ether_addr_equal(e->lladdr, msg->lladdr))
+				return false;
+			ether_addr_copy(e->lladdr, msg->lladdr);
+			return true;
+		}
+	if (xn->n >= xeth_neigh_max_entries)
+		xeth_neigh_forget(xn, list_first_entry(&xn->lru,
+						       struct xeth_neigh_entry,
+						       lru));
+	/* if this fails, the next update of the neighbour is sent too */
+	e = kzalloc(sizeof(*e), GFP_ATOMIC);
+	if (e) {
+		memcpy(e->key, key, xeth_neigh_keylen);
+		ether_addr_copy(e->lladdr, msg->lladdr);
+		hash_add(xn->ht, &e->node, hash);
+		list_add_tail(&e->lru, &xn->lru);
+		xn->n++;
+	}
+	return true;
+}
+
+/**
+ * xeth_neigh_send() - queue the update if it's a change
+ *
+ * The lock is held while queuing so that concurrent updates of a neighbour
+ * are queued in the order cached. A queued update that no client has sent
+ * yet is superseded by the next of the same key.
+ */
+int xeth_neigh_send(struct net_device *mux,
+		    const struct xeth_msg_neigh_update *msg)
+{
+	struct xeth_neigh *xn = xeth_mux_neigh(mux);
+	struct xeth_sbtxb *sbtxb;
+	int err = 0;
+
+	spin_lock_bh(&xn->lock);
+	if (!xeth_neigh_changed(xn, msg)) {
+		xeth_mux_inc_sbtx_unchanged(mux);
+		goto xeth_neigh_send_unlock;
+	}
+	sbtxb = xeth_mux_alloc_sbtxb(mux, sizeof(*msg));
+	if (!sbtxb) {
+		err = -ENOMEM;
+		goto xeth_neigh_send_unlock;
+	}
+	memcpy(xeth_sbtxb_data(sbtxb), msg, sizeof(*msg));
+	xeth_sbtxb_set_key(sbtxb, (const u8 *)msg + xeth_neigh_keyoff,
+			   xeth_neigh_keylen);
+	xeth_mux_queue_sbtx(mux, sbtxb);
+xeth_neigh_send_unlock:
+	spin_unlock_bh(&xn->lock);
+	return err;
+}
+
+/**
+ * xeth_neigh_dump() - send the valid neighbours remembered to a dump's
+ * requester
+ *
+ * The lock keeps a concurrent update from being queued ahead of the dumped
+ * state it changes. A neighbour that isn't remembered is sent to all with
+ * its next update.
+ */
+void xeth_neigh_dump(struct net_device *mux)
+{
+	struct xeth_neigh *xn = xeth_mux_neigh(mux);
+	struct xeth_msg_neigh_update *msg;
+	struct xeth_neigh_entry *e;
+	struct xeth_sbtxb *sbtxb;
+
+	spin_lock_bh(&xn->lock);
+	list_for_each_entry(e, &xn->lru, lru) {
+		if (is_zero_ether_addr(e->lladdr))
+			continue;
+		sbtxb = xeth_mux_alloc_sbtxb(mux, sizeof(*msg));
+		if (!sbtxb)
+			break;
+		msg = xeth_sbtxb_data(sbtxb);
+		xeth_msg_init(msg, XETH_MSG_KIND_NEIGH_UPDATE);
+		memcpy((u8 *)msg + xeth_neigh_keyoff, e->key, xeth_neigh_keylen);
+		ether_addr_copy(msg->lladdr, e->lladdr);
+		xeth_sbtxb_set_key(sbtxb, e->key, xeth_neigh_keylen);
+		xeth_mux_queue_sbtx(mux, sbtxb);
+	}
+	spin_unlock_bh(&xn->lock);
+}
+
+/* Forget what was sent, with the mux. */
+void xeth_neigh_flush(struct net_device *mux)
+{
+	struct xeth_neigh *xn = xeth_mux_neigh(mux);
+	struct xeth_neigh_entry *e, *tmp;
+
+	spin_lock_bh(&xn->lock);
+	list_for_each_entry_safe(e, tmp, &xn->lru, lru)
+		xeth_neigh_forget(xn, e);
+	spin_unlock_bh(&xn->lock);
+}
@@ -0,0 +1,47 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0
+ * Copyright(c) 2018-2020 Platina Systems, Inc.
+ *
+ * Contact Information:
+ * sw@platina.com
+ * Platina Systems, 3180 Del La Cruz Blvd, Santa Clara, CA 95054
+ */
+
+#ifndef __NET_ETHERNET_XETH_NEIGH_H
+#define __NET_ETHERNET_XETH_NEIGH_H
+
+#include "xeth.h"
+#include <linux/netdevice.h>
+#include <linux/hashtable.h>
+
+enum {
+	xeth_neigh_hash_bits = 10,
+	/* neighbours remembered, beyond which the least recent is forgotten */
+	xeth_neigh_max_entries = 8192,
+};
+
+/**
+ * struct xeth_neigh - the last lladdr sent of each neighbour, zero if invalid
+ *
+ * Neighbour refreshes and NUD transitions that don't change the lladdr or
+ * validity of a remembered neighbour aren't sent. Any update of a
+ * neighbour that isn't remembered, whether never seen, flushed, evicted
+ * by @lru past the bound, or not cached for lack of memory, is sent,
+ * since the controller may still have an earlier lladdr.
+ */
+struct xeth_neigh {
+	spinlock_t lock;
+	DECLARE_HASHTABLE(ht, xeth_neigh_hash_bits);
+	struct list_head lru;
+	size_t n;
+};
+
+struct xeth_neigh *xeth_mux_neigh(struct net_device *mux);
+
+void xeth_neigh_init(struct xeth_neigh *);
+int xeth_neigh_send(struct net_device *mux,
+		    const struct xeth_msg_neigh_update *msg);
+void xeth_neigh_dump(struct net_device *mux);
+void xeth_neigh_flush(struct net_device *mux);
+
+#endif	/* __NET_ETHERNET_XETH_NEIGH_H */
@@ -0,0 +1,222 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0
+ * Copyright(c) 2018-2020 Platina Systems, Inc.
+ *
+ * Contact Information:
+ * sw@platina.com
+ * Platina Systems, 3180 Del La Cruz Blvd, Santa Clara, CA 95054
+ */
+
+#include "xeth_nh.h"
+#include "xeth_mux.h"
+#include "xeth_sbtx.h"
+#include "xeth_debug.h"
+#include <linux/jhash.h>
+#include <net/nexthop.h>
+
+struct xeth_nh_entry {
+	struct hlist_node node;
+	struct list_head lru;
+	u64 net;
+	u32 id, sig;
+	/* @seq: of the last export, 0 if none */
+	u64 seq;
+	/* @dump, @dump_sig, @dump_seq: the same of the export to the
+	 * requester of dump number @dump
+	 */
+	u32 dump, dump_sig;
+	u64 dump_seq;
+};
+
+void xeth_nh_init(struct xeth_nh *xnh)
+{
+	spin_lock_init(&xnh->mutex);
+	hash_init(xnh->ht);
+	INIT_LIST_HEAD(&xnh->lru);
+	xnh->n = 0;
+}
+
+/* call with xnh lock held */
+static void xeth_nh_forget(struct xeth_nh *xnh, struct xeth_nh_entry *e)
+{
+	hash_del(&e->node);
+	list_del(&e->lru);
+	xnh->n--;
+	kfree(e);
+}
+
+/* call with xnh lock held; return NULL if out of memory */
+static struct xeth_nh_entry *xeth_nh_entry(struct xeth_nh *xnh, u64 net,
+					   u32 id)
+{
+	struct xeth_nh_entry *e;
+
+	hash_for_each_possible(xnh->ht, e, node, id)
+		if (e->net == net && e->id == id) {
+			list_move_tail(&e->lru, &xnh->lru);
+			return e;
+		}
+	if (xnh->n >= xeth_nh_max_entries)
+		xeth_nh_forget(xnh, list_first_entry(&xnh->lru,
+						     struct xeth_nh_entry,
+						     lru));
+	e = kzalloc(sizeof(*e), GFP_ATOMIC);
+	if (e) {
+		e->net = net;
+		e->id = id;
+		hash_add(xnh->ht, &e->node, id);
+		list_add_tail(&e->lru, &xnh->lru);
+		xnh->n++;
+	}
+	return e;
+}
+
+static u32 xeth_nh_info_sig(struct nh_info *nhi)
+{
+	struct fib_nh_common *nhc = &nhi->fib_nhc;
+	struct {
+		s32 ifindex;
+		u32 flags;
+		u8 scope, reject, family, gw_family;
+		u8 gw[16];
+	} k;
+
+	memset(&k, 0, sizeof(k));
+	k.ifindex = nhc->nhc_dev ? nhc->nhc_dev->ifindex : 0;
+	k.flags = nhc->nhc_flags;
+	k.scope = nhc->nhc_scope;
+	k.reject = nhi->reject_nh;
+	k.family = nhc->nhc_family;
+	k.gw_family = nhc->nhc_gw_family;
+	if (nhc->nhc_gw_family == AF_INET)
+		memcpy(k.gw, &nhc->nhc_gw.ipv4, 4);
+	else if (nhc->nhc_gw_family == AF_INET6)
+		memcpy(k.gw, &nhc->nhc_gw.ipv6, 16);
+	return jhash(&k, sizeof(k), 0);
+}
+
+/* call with xnh lock held; return the sequence number of the export of
+ * @sig to the receivers of a message queued now, or 0 if there's none; a
+ * dump's requester, @dump, may not have had any earlier export
+ */
+static u64 xeth_nh_exported(struct xeth_nh_entry *e, u32 dump, u32 sig)
+{
+	if (!e)
+		return 0;
+	if (dump)
+		return e->dump == dump && e->dump_sig == sig ? e->dump_seq : 0;
+	return e->sig == sig ? e->seq : 0;
+}
+
+/* call with xnh lock held */
+static void xeth_nh_set_exported(struct xeth_nh_entry *e, u32 dump, u32 sig,
+				 u64 seq)
+{
+	if (!e)
+		return;
+	if (dump) {
+		e->dump = dump;
+		e->dump_sig = sig;
+		e->dump_seq = seq;
+	} else {
+		e->sig = sig;
+		e->seq = seq;
+	}
+}
+
+/* call with xnh and rcu read locks held; return the export sequence number,
+ * or U64_MAX if it isn't known
+ */
+static u64 xeth_nh_export_info(struct net_device *mux, struct xeth_nh *xnh,
+			       u64 net, struct nexthop *nh, u32 dump)
+{
+	struct nh_info *nhi = rcu_dereference(nh->nh_info);
+	struct xeth_nh_entry *e = xeth_nh_entry(xnh, net, nh->id);
+	u32 sig = xeth_nh_info_sig(nhi);
+	u64 seq = xeth_nh_exported(e, dump, sig);
+
+	if (seq)
+		return seq;
+	xeth_sbtx_nexthop(mux, net, nh->id, &nhi->fib_nhc, nhi->reject_nh,
+			  FIB_EVENT_NH_ADD, &seq);
+	if (!e)
+		return U64_MAX;
+	xeth_nh_set_exported(e, dump, sig, seq);
+	return seq ? seq : U64_MAX;
+}
+
+/**
+ * xeth_nh_export() - send nexthop object, and any group members, if new or
+ * changed since last sent
+ *
+ * Call before sending the route that references @nh. The lock is held while
+ * queuing so that a concurrent reference can't precede the object. A dump
+ * exports each object to its requester once, whatever was sent before.
+ *
+ * Return: the sequence number of the latest export of @nh or its members, so
+ * that the route isn't superseded into a place ahead of them.
+ */
+u64 xeth_nh_export(struct net_device *mux, u64 net, struct nexthop *nh)
+{
+	struct xeth_nh *xnh = xeth_mux_nh(mux);
+	struct xeth_nh_entry *e;
+	struct nh_group *nhg;
+	struct nh_grp_entry *nhge;
+	u32 dump = xeth_mux_dumping(mux);
+	u64 seq, after = 0;
+	u32 sig;
+	int i;
+
+	rcu_read_lock();
+	spin_lock_bh(&xnh->mutex);
+	if (nh->is_group) {
+		nhg = rcu_dereference(nh->nh_grp);
+		sig = nhg->mpath;
+		for (i = 0; i < nhg->num_nh; i++) {
+			nhge = &nhg->nh_entries[i];
+			after = max(after, xeth_nh_export_info(mux, xnh, net,
+							       nhge->nh, dump));
+			sig = jhash_2words(nhge->nh->id, nhge->weight, sig);
+		}
+		e = xeth_nh_entry(xnh, net, nh->id);
+		seq = xeth_nh_exported(e, dump, sig);
+		if (!seq) {
+			xeth_sbtx_nexthop_group(mux, net, nh->id, nhg, &seq);
+			xeth_nh_set_exported(e, dump, sig, seq);
+			if (!e || !seq)
+				seq = U64_MAX;
+		}
+		after = max(after, seq);
+	} else
+		after = xeth_nh_export_info(mux, xnh, net, nh, dump);
+	spin_unlock_bh(&xnh->mutex);
+	rcu_read_unlock();
+	return after;
+}
+
+/* Forget what was sent, with the mux. */
+void xeth_nh_flush(struct net_device *mux)
+{
+	struct xeth_nh *xnh = xeth_mux_nh(mux);
+	struct xeth_nh_entry *e;
+	struct hlist_node *tmp;
+	int bkt;
+
+	spin_lock_bh(&xnh->mutex);
+	hash_for_each_safe(xnh->ht, bkt, tmp, e, node)
+		xeth_nh_forget(xnh, e);
+	spin_unlock_bh(&xnh->mutex);
+}
+
+/* Forget the exports of a deleted netns, whose ids may be reused. */
+void xeth_nh_flush_net(struct net_device *mux, u64 net)
+{
+	struct xeth_nh *xnh = xeth_mux_nh(mux);
+	struct xeth_nh_entry *e, *tmp;
+
+	spin_lock_bh(&xnh->mutex);
+	list_for_each_entry_safe(e, tmp, &xnh->lru, lru)
+		if (e->net == net)
+			xeth_nh_forget(xnh, e);
+	spin_unlock_bh(&xnh->mutex);
+}
@@ -0,0 +1,50 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0
+ * Copyright(c) 2018-2020 Platina Systems, Inc.
+ *
+ * Contact Information:
+ * sw@platina.com
+ * Platina Systems, 3180 Del La Cruz Blvd, Santa Clara, CA 95054
+ */
+
+#ifndef __NET_ETHERNET_XETH_NH_H
+#define __NET_ETHERNET_XETH_NH_H
+
+#include <linux/netdevice.h>
+#include <linux/hashtable.h>
+
+enum {
+	xeth_nh_hash_bits = 8,
+	/* exports remembered, beyond which the least recent is forgotten */
+	xeth_nh_max_entries = 4096,
+};
+
+struct nexthop;
+
+/**
+ * struct xeth_nh - nexthop objects sent to the controller
+ *
+ * Nexthop objects aren't notified by this kernel on their own, so they're
+ * exported with the first route that references them and again whenever
+ * their signature changes.
+ *
+ * Nor is their deletion, so the exports remembered are bounded instead;
+ * @lru orders them by last reference, and those of a deleted netns are
+ * forgotten with it. A forgotten object is just exported again if
+ * referenced.
+ */
+struct xeth_nh {
+	spinlock_t mutex;
+	DECLARE_HASHTABLE(ht, xeth_nh_hash_bits);
+	struct list_head lru;
+	size_t n;
+};
+
+struct xeth_nh *xeth_mux_nh(struct net_device *mux);
+
+void xeth_nh_init(struct xeth_nh *);
+u64 xeth_nh_export(struct net_device *mux, u64 net, struct nexthop *);
+void xeth_nh_flush(struct net_device *mux);
+void xeth_nh_flush_net(struct net_device *mux, u64 net);
+
+#endif	/* __NET_ETHERNET_XETH_NH_H */
@@ -22,10 +22,56 @@ enum {
 static const char xeth_port_drvname[] = "xeth-port";
 static ssize_t xeth_port_subports(size_t port);
 
+/**
+ * struct xeth_port_stats - ethtool stats of the controller
+ * @n: sized by the named stats, or more if the controller writes past them
+ * @time: of the sample, see XETH_MSG_KIND_ETHTOOL_STATS
+ */
+struct xeth_port_stats {
+	struct rcu_head rcu;
+	u32 n;
+	u64 time;
+	u64 count[];
+};
+
 struct xeth_port_ext {
+	/* @qsfp_mutex: guards @qsfp and its cache from the irq threads */
+	struct mutex qsfp_mutex;
 	struct i2c_client *qsfp;
+	struct xeth_qsfp_cache qsfp_cache;
+	/* @absent_irq, @intr_irq: > 0 if requested */
+	int qsfp_bus, absent_irq, intr_irq;
+	struct work_struct qsfp_work;
+	/* @probe_work: re-probes a present module until it answers;
+	 * @probe_tries, under @qsfp_mutex, sets its backoff
+	 */
+	struct delayed_work probe_work;
+	unsigned int probe_tries;
+	struct delayed_work dom_work;
 	u32 priv_flags;
-	atomic64_t stats[xeth_mux_max_stats];
+	/* @stats_lock: writers of @stats, so that readers see whole updates;
+	 * to grow, @stats is replaced under the lock and freed after RCU
+	 */
+	seqlock_t stats_lock;
+	struct xeth_port_stats __rcu *stats;
+	/* @stats_dead: set by uninit under @stats_lock for late writers */
+	bool stats_dead;
+	/* @stats_named: named stats counted by the last get_sset_count,
+	 * which sized the buffer of the following get_strings
+	 */
+	u32 stats_named;
+};
+
+/* appended to the stats named by the controller */
+static const char xeth_port_time_stat_names[][ETH_GSTRING_LEN] = {
+	"stats_time_ns",
+	"link_stats_time_ns",
+};
+
+enum {
+	/* after the named stats, the times then the module monitors */
+	xeth_port_n_trailer_stats = ARRAY_SIZE(xeth_port_time_stat_names) +
+		xeth_qsfp_n_dom_stats,
 };
 
 struct xeth_port_priv {
@@ -48,14 +94,52 @@ int xeth_port_subport(struct net_device *nd)
 	return priv->subport;
 }
 
+static struct xeth_port_stats *xeth_port_stats_alloc(u32 n)
+{
+	struct xeth_port_stats *st;
+
+	st = kzalloc(struct_size(st, count, n), GFP_KERNEL);
+	if (st)
+		st->n = n;
+	return st;
+}
+
 static void xeth_port_uninit(struct net_device *nd)
 {
 	struct xeth_port_priv *priv = netdev_priv(nd);
+	if (priv->subport <= 0) {
+		cancel_work_sync(&priv->ext[0].qsfp_work);
+		cancel_delayed_work_sync(&priv->ext[0].dom_work);
+		if (priv->ext[0].absent_irq > 0)
+			free_irq(priv->ext[0].absent_irq, priv);
+		if (priv->ext[0].intr_irq > 0)
+			free_irq(priv->ext[0].intr_irq, priv);
+		priv->ext[0].absent_irq = 0;
+		priv->ext[0].intr_irq = 0;
+		/* after the irqs, whose threads may queue a retry */
+		cancel_delayed_work_sync(&priv->ext[0].probe_work);
+	}
 	if (priv->subport <= 0 && priv->ext[0].qsfp) {
 		i2c_unregister_device(priv->ext[0].qsfp);
 		priv->ext[0].qsfp = NULL;
 	}
 	xeth_proxy_uninit(nd);
+	/* sbrx may still be writing stats by a proxy found before its
+	 * removal, so take the lock and leave them to any reader's grace
+	 */
+	if (priv->subport <= 0) {
+		struct xeth_port_ext *ext = &priv->ext[0];
+		struct xeth_port_stats *st;
+
+		write_seqlock_bh(&ext->stats_lock);
+		ext->stats_dead = true;
+		st = rcu_dereference_protected(ext->stats,
+				lockdep_is_held(&ext->stats_lock.lock));
+		RCU_INIT_POINTER(ext->stats, NULL);
+		write_sequnlock_bh(&ext->stats_lock);
+		if (st)
+			kfree_rcu(st, rcu);
+	}
 }
 
 static int xeth_port_open(struct net_device *nd)
@@ -98,21 +182,73 @@ xeth_port_ethtool_ksettings(struct net_device *nd)
 void xeth_port_reset_ethtool_stats(struct net_device *nd)
 {
 	struct xeth_port_priv *priv = netdev_priv(nd);
-	int i;
+	struct xeth_port_ext *ext = &priv->ext[0];
+	struct xeth_port_stats *st;
 
-	if (priv->subport <= 0)
-		for (i = 0; i < ARRAY_SIZE(priv->ext[0].stats); i++)
-			atomic64_set(&priv->ext[0].stats[i], 0LL);
+	if (priv->subport > 0)
+		return;
+	write_seqlock_bh(&ext->stats_lock);
+	st = rcu_dereference_protected(ext->stats,
+				       lockdep_is_held(&ext->stats_lock.lock));
+	if (st) {
+		memset(st->count, 0, st->n * sizeof(st->count[0]));
+		st->time = 0;
+	}
+	write_sequnlock_bh(&ext->stats_lock);
 }
 
-void xeth_port_ethtool_stat(struct net_device *nd, u32 index, u64 count)
+/* Set @n counts from ethtool stat @first as one update, sampled at @time
+ * unless 0. Call from process context; the stats are grown to fit.
+ */
+void xeth_port_ethtool_stats(struct net_device *nd, u32 first, u32 n,
+			     const u64 *count, u64 time)
 {
 	struct xeth_port_priv *priv = netdev_priv(nd);
+	struct xeth_port_ext *ext = &priv->ext[0];
+	struct xeth_port_stats *st, *grown = NULL;
+	u32 need = first + n, have;
 
-	if (index < ARRAY_SIZE(priv->ext[0].stats))
-		atomic64_set(&priv->ext[0].stats[index], count);
-	else
+	if (priv->subport > 0 || first >= xeth_mux_max_stats ||
+	    n > xeth_mux_max_stats - first) {
 		xeth_mux_inc_sbrx_invalid(priv->proxy.mux);
+		return;
+	}
+	rcu_read_lock();
+	st = rcu_dereference(ext->stats);
+	have = st ? st->n : 0;
+	rcu_read_unlock();
+	if (have < need) {
+		grown = xeth_port_stats_alloc(max_t(u32, need,
+			xeth_mux_n_stats(priv->proxy.mux)));
+		if (!grown) {
+			xeth_mux_inc_sbrx_no_mem(priv->proxy.mux);
+			return;
+		}
+	}
+	write_seqlock_bh(&ext->stats_lock);
+	if (ext->stats_dead) {
+		write_sequnlock_bh(&ext->stats_lock);
+		kfree(grown);
+		return;
+	}
+	st = rcu_dereference_protected(ext->stats,
+				       lockdep_is_held(&ext->stats_lock.lock));
+	if (grown && (!st || st->n < grown->n)) {
+		if (st) {
+			memcpy(grown->count, st->count,
+			       st->n * sizeof(st->count[0]));
+			grown->time = st->time;
+			kfree_rcu(st, rcu);
+		}
+		rcu_assign_pointer(ext->stats, grown);
+		st = grown;
+		grown = NULL;
+	}
+	memcpy(&st->count[first], count, n * sizeof(*count));
+	if (time)
+		st->time = time;
+	write_sequnlock_bh(&ext->stats_lock);
+	kfree(grown);
 }
 
 void xeth_port_speed(struct net_device *nd, u32 mbps)
@@ -144,7 +280,8 @@ static void xeth_port_get_drvinfo(struct net_device *nd,
 	strlcpy(drvinfo->fw_version, "n/a", ETHTOOL_FWVERS_LEN);
 	strlcpy(drvinfo->erom_version, "n/a", ETHTOOL_EROMVERS_LEN);
 	drvinfo->n_priv_flags = xeth_mux_n_priv_flags(priv->proxy.mux);
-	drvinfo->n_stats = xeth_mux_n_stats(priv->proxy.mux);
+	drvinfo->n_stats = xeth_mux_n_stats(priv->proxy.mux) +
+		xeth_port_n_trailer_stats;
 	scnprintf(drvinfo->bus_info, ETHTOOL_BUSINFO_LEN, "%u:%u",
 		  priv->port, priv->proxy.xid);
 }
@@ -174,7 +311,9 @@ static int xeth_port_get_sset_count(struct net_device *nd, int sset)
 		n = 0;
 		break;
 	case ETH_SS_STATS:
-		n = xeth_mux_n_stats(priv->proxy.mux);
+		/* both under rtnl, so get_strings sees this count */
+		priv->ext[0].stats_named = xeth_mux_n_stats(priv->proxy.mux);
+		n = priv->ext[0].stats_named + xeth_port_n_trailer_stats;
 		break;
 	case ETH_SS_PRIV_FLAGS:
 		n = xeth_mux_n_priv_flags(priv->proxy.mux);
@@ -189,12 +328,22 @@ static int xeth_port_get_sset_count(struct net_device *nd, int sset)
 static void xeth_port_get_strings(struct net_device *nd, u32 sset, u8 *data)
 {
 	struct xeth_port_priv *priv = netdev_priv(nd);
+	size_t n, named;
 
 	switch (sset) {
 	case ETH_SS_TEST:
 		break;
 	case ETH_SS_STATS:
-		xeth_mux_stat_names(priv->proxy.mux, data);
+		/* the names may have changed since get_sset_count */
+		n = priv->ext[0].stats_named;
+		named = xeth_mux_stat_names(priv->proxy.mux, data, n);
+		memset(data + (named * ETH_GSTRING_LEN), 0,
+		       (n - named) * ETH_GSTRING_LEN);
+		memcpy(data + (n * ETH_GSTRING_LEN), xeth_port_time_stat_names,
+		       sizeof(xeth_port_time_stat_names));
+		n += ARRAY_SIZE(xeth_port_time_stat_names);
+		memcpy(data + (n * ETH_GSTRING_LEN), xeth_qsfp_dom_stat_names,
+		       xeth_qsfp_n_dom_stats * ETH_GSTRING_LEN);
 		break;
 	case ETH_SS_PRIV_FLAGS:
 		xeth_mux_priv_flag_names(priv->proxy.mux, data);
@@ -208,10 +357,35 @@ static void xeth_port_get_stats(struct net_device *nd,
 				struct ethtool_stats *stats, u64 *data)
 {
 	struct xeth_port_priv *priv = netdev_priv(nd);
-	int i, n = xeth_mux_n_stats(priv->proxy.mux);
-
-	for (i = 0; i < n; i++)
-		data[i] = atomic64_read(&priv->ext[0].stats[i]);
+	struct xeth_port_ext *ext = &priv->ext[0];
+	struct xeth_port_stats *st;
+	unsigned seq;
+	u32 n, have;
+
+	/* @data was sized by an earlier get_sset_count; more stats may have
+	 * been named since
+	 */
+	if (WARN_ON(stats->n_stats < xeth_port_n_trailer_stats))
+		return;
+	n = stats->n_stats - xeth_port_n_trailer_stats;
+	xeth_proxy_pull_stats(nd, XETH_STATS_REQUEST_ETHTOOL, true);
+	rcu_read_lock();
+	do {
+		seq = read_seqbegin(&ext->stats_lock);
+		st = rcu_dereference(ext->stats);
+		have = st ? min(n, st->n) : 0;
+		if (have)
+			memcpy(data, st->count, have * sizeof(*data));
+		data[n] = st ? st->time : 0;
+	} while (read_seqretry(&ext->stats_lock, seq));
+	rcu_read_unlock();
+	memset(&data[have], 0, (n - have) * sizeof(*data));
+	data[n + 1] = xeth_proxy_link_stats_time(nd);
+	/* as sampled, never read from the module here */
+	mutex_lock(&ext->qsfp_mutex);
+	xeth_qsfp_dom_stats(&ext->qsfp_cache,
+			    &data[n + ARRAY_SIZE(xeth_port_time_stat_names)]);
+	mutex_unlock(&ext->qsfp_mutex);
 }
 
 static u32 xeth_port_get_priv_flags(struct net_device *nd)
@@ -509,21 +683,50 @@ static int xeth_port_set_fecparam(struct net_device *nd,
 	return xeth_sbtx_et_settings(priv->proxy.mux, priv->proxy.xid, ks);
 }
 
+/* Return the module's client, or NULL if absent; call with qsfp mutex. */
+static struct i2c_client *xeth_port_qsfp_present(struct xeth_port_priv *priv)
+{
+	struct gpio_desc *absent_gpio =
+		xeth_mux_qsfp_absent_gpio(priv->proxy.mux, priv->port);
+
+	if (!priv->ext[0].qsfp)
+		return NULL;
+	if (absent_gpio && gpiod_get_value_cansleep(absent_gpio)) {
+		xeth_qsfp_invalidate(&priv->ext[0].qsfp_cache);
+		return NULL;
+	}
+	return priv->ext[0].qsfp;
+}
+
 int xeth_port_get_module_info(struct net_device *nd,
 			      struct ethtool_modinfo *emi)
 {
 	struct xeth_port_priv *priv = netdev_priv(nd);
-	return priv->ext[0].qsfp ?
-		xeth_qsfp_get_module_info(priv->ext[0].qsfp, emi) : -ENXIO;
+	struct i2c_client *qsfp;
+	int err;
+
+	mutex_lock(&priv->ext[0].qsfp_mutex);
+	qsfp = xeth_port_qsfp_present(priv);
+	err = qsfp ? xeth_qsfp_get_module_info(qsfp, &priv->ext[0].qsfp_cache,
+					       emi) : -ENXIO;
+	mutex_unlock(&priv->ext[0].qsfp_mutex);
+	return err;
 }
 
 int xeth_port_get_module_eeprom(struct net_device *nd,
 				struct ethtool_eeprom *ee, u8 *data)
 {
 	struct xeth_port_priv *priv = netdev_priv(nd);
-	return priv->ext[0].qsfp ?
-		xeth_qsfp_get_module_eeprom(priv->ext[0].qsfp, ee, data) :
-		-ENXIO;
+	struct i2c_client *qsfp;
+	int err;
+
+	mutex_lock(&priv->ext[0].qsfp_mutex);
+	qsfp = xeth_port_qsfp_present(priv);
+	err = qsfp ? xeth_qsfp_get_module_eeprom(qsfp,
+						 &priv->ext[0].qsfp_cache,
+						 ee, data) : -ENXIO;
+	mutex_unlock(&priv->ext[0].qsfp_mutex);
+	return err;
 }
 
 static const struct ethtool_ops xeth_port_eto = {
@@ -567,22 +770,192 @@ static void xeth_port_setup(struct net_device *nd)
 	nd->priv_flags |= IFF_DONT_BRIDGE;
 }
 
-static void xeth_port_qsfp(struct xeth_port_priv *priv, u8 bus)
+enum {
+	/* a module may take 2s after insertion or reset to answer, so
+	 * retry at 100, 200, 400, 800, 1600 and 3200ms after the first try
+	 */
+	xeth_port_qsfp_retry_ms = 100,
+	xeth_port_qsfp_max_tries = 6,
+};
+
+/**
+ * xeth_port_qsfp_probe() - add or drop the client of an inserted or removed
+ * module and tell the controller
+ *
+ * A present module that doesn't answer yet is probed again by
+ * @probe_work with backoff.
+ *
+ * Call from process context.
+ */
+static void xeth_port_qsfp_probe(struct xeth_port_priv *priv)
 {
+	struct xeth_port_ext *ext = &priv->ext[0];
 	struct gpio_desc *absent_gpio =
 		xeth_mux_qsfp_absent_gpio(priv->proxy.mux, priv->port);
 	struct gpio_desc *reset_gpio =
 		xeth_mux_qsfp_reset_gpio(priv->proxy.mux, priv->port);
 	const unsigned short const *addrs =
 		xeth_mux_qsfp_i2c_addrs(priv->proxy.mux);
+	int event = -1;
+
+	mutex_lock(&ext->qsfp_mutex);
+	if (gpiod_get_value_cansleep(absent_gpio)) {
+		if (ext->qsfp) {
+			i2c_unregister_device(ext->qsfp);
+			ext->qsfp = NULL;
+			event = XETH_QSFP_EVENT_REMOVED;
+		}
+		xeth_qsfp_invalidate(&ext->qsfp_cache);
+		ext->probe_tries = 0;
+		cancel_delayed_work(&ext->probe_work);
+	} else if (!ext->qsfp) {
+		gpiod_set_value_cansleep(reset_gpio, 0);
+		xeth_qsfp_invalidate(&ext->qsfp_cache);
+		ext->qsfp = xeth_qsfp_client(ext->qsfp_bus, addrs);
+		if (ext->qsfp) {
+			/* a failure is retried by the next reader */
+			xeth_qsfp_cache_load(ext->qsfp, &ext->qsfp_cache);
+			event = XETH_QSFP_EVENT_INSERTED;
+			ext->probe_tries = 0;
+		} else if (ext->probe_tries < xeth_port_qsfp_max_tries) {
+			unsigned long ms =
+				xeth_port_qsfp_retry_ms << ext->probe_tries++;
+			mod_delayed_work(system_wq, &ext->probe_work,
+					 msecs_to_jiffies(ms));
+		} else
+			xeth_debug("qsfp[%d] not found @%d", priv->port,
+				   ext->qsfp_bus);
+	}
+	mutex_unlock(&ext->qsfp_mutex);
+	if (event >= 0)
+		xeth_sbtx_qsfp(priv->proxy.mux, priv->proxy.xid, event, NULL);
+}
+
+static void xeth_port_qsfp_probe_work(struct work_struct *work)
+{
+	struct xeth_port_ext *ext =
+		container_of(to_delayed_work(work), struct xeth_port_ext,
+			     probe_work);
+
+	xeth_port_qsfp_probe(container_of(ext, struct xeth_port_priv,
+					  ext[0]));
+}
+
+static irqreturn_t xeth_port_qsfp_absent_irq(int irq, void *data)
+{
+	xeth_port_qsfp_probe(data);
+	return IRQ_HANDLED;
+}
+
+static irqreturn_t xeth_port_qsfp_intr_irq(int irq, void *data)
+{
+	struct xeth_port_priv *priv = data;
+	struct xeth_port_ext *ext = &priv->ext[0];
+	u8 flags[xeth_qsfp_n_flags];
+	int err = -ENXIO;
+
+	mutex_lock(&ext->qsfp_mutex);
+	if (ext->qsfp)
+		err = xeth_qsfp_get_flags(ext->qsfp, flags);
+	mutex_unlock(&ext->qsfp_mutex);
+	if (!err)
+		xeth_sbtx_qsfp(priv->proxy.mux, priv->proxy.xid,
+			       XETH_QSFP_EVENT_INTERRUPT, flags);
+	return IRQ_HANDLED;
+}
+
+/* Return the irq of a threaded handler for edges of @gpio, or 0. */
+static int xeth_port_qsfp_irq(struct xeth_port_priv *priv,
+			      struct gpio_desc *gpio, irq_handler_t fn,
+			      unsigned long edges)
+{
+	int irq, err;
+
+	if (!gpio)
+		return 0;
+	irq = gpiod_to_irq(gpio);
+	if (irq <= 0)
+		return 0;
+	err = request_threaded_irq(irq, NULL, fn, IRQF_ONESHOT | edges,
+				   priv->proxy.nd->name, priv);
+	if (err) {
+		xeth_debug("qsfp[%d] irq %d: %d", priv->port, irq, err);
+		return 0;
+	}
+	return irq;
+}
+
+static uint xeth_port_dom_interval = 5000;
+
+module_param_named(dom_interval, xeth_port_dom_interval, uint, 0444);
+MODULE_PARM_DESC(dom_interval, " ms between samples of each module's "
+		 "monitors, 0 to not sample");
+
+/* Sample the monitors of the port's module, if present, at a constant
+ * rate regardless of readers; without an IntL irq, also poll its latched
+ * alarm and warning flags and send any as an interrupt.
+ */
+static void xeth_port_dom_work(struct work_struct *work)
+{
+	struct xeth_port_ext *ext =
+		container_of(to_delayed_work(work), struct xeth_port_ext,
+			     dom_work);
+	struct xeth_port_priv *priv =
+		container_of(ext, struct xeth_port_priv, ext[0]);
+	u8 flags[xeth_qsfp_n_flags];
+	bool poll = ext->intr_irq <= 0;
+	struct i2c_client *qsfp;
+	int err = -ENXIO;
+
+	mutex_lock(&ext->qsfp_mutex);
+	qsfp = xeth_port_qsfp_present(priv);
+	if (qsfp)
+		err = xeth_qsfp_dom_sample(qsfp, &ext->qsfp_cache,
+					   poll ? flags : NULL);
+	mutex_unlock(&ext->qsfp_mutex);
+	if (!err && poll && memchr_inv(flags, 0, sizeof(flags)))
+		xeth_sbtx_qsfp(priv->proxy.mux, priv->proxy.xid,
+			       XETH_QSFP_EVENT_INTERRUPT, flags);
+	schedule_delayed_work(&ext->dom_work,
+			      msecs_to_jiffies(xeth_port_dom_interval));
+}
+
+/* Follow the module's insertion and removal by the absent line and its
+ * alarms by the IntL line, then probe it, if present; the irqs come first
+ * so that no edge is lost between the probe and their request. This is
+ * queued after the port registers so that ports don't wait on each
+ * other's I2C.
+ */
+static void xeth_port_qsfp_work(struct work_struct *work)
+{
+	struct xeth_port_ext *ext =
+		container_of(work, struct xeth_port_ext, qsfp_work);
+	struct xeth_port_priv *priv =
+		container_of(ext, struct xeth_port_priv, ext[0]);
+	struct gpio_desc *absent_gpio =
+		xeth_mux_qsfp_absent_gpio(priv->proxy.mux, priv->port);
+	struct gpio_desc *reset_gpio =
+		xeth_mux_qsfp_reset_gpio(priv->proxy.mux, priv->port);
+	struct gpio_desc *intr_gpio =
+		xeth_mux_qsfp_intr_gpio(priv->proxy.mux, priv->port);
+
 	if (!absent_gpio || !reset_gpio)
 		return;
-	if (gpiod_get_value_cansleep(absent_gpio))
-		return;
-	gpiod_set_value_cansleep(reset_gpio, 0);
-	priv->ext[0].qsfp = xeth_qsfp_client(bus, addrs);
-	if (!priv->ext[0].qsfp)
-		xeth_debug("qsfp[%d] not found @%d", priv->port, bus);
+	ext->absent_irq = xeth_port_qsfp_irq(priv, absent_gpio,
+					     xeth_port_qsfp_absent_irq,
+					     IRQF_TRIGGER_RISING |
+					     IRQF_TRIGGER_FALLING);
+	ext->intr_irq = xeth_port_qsfp_irq(priv, intr_gpio,
+					   xeth_port_qsfp_intr_irq,
+					   IRQF_TRIGGER_FALLING);
+	xeth_port_qsfp_probe(priv);
+	/* spread the first samples of ports through the interval by bus
+	 * so that those sharing a mux or controller don't sample at once
+	 */
+	if (xeth_port_dom_interval) {
+		uint first = xeth_port_dom_interval * (ext->qsfp_bus % 16) / 16;
+		schedule_delayed_work(&ext->dom_work, msecs_to_jiffies(first));
+	}
 }
 
 static int xeth_port_validate(struct nlattr *tb[], struct nlattr *data[],
@@ -618,6 +991,12 @@ static int xeth_port_newlink(struct net *src_net, struct net_device *nd,
 	nd->max_mtu = priv->proxy.mux->max_mtu;
 	priv->port = -1;
 	priv->subport = -1;
+	seqlock_init(&priv->ext[0].stats_lock);
+	mutex_init(&priv->ext[0].qsfp_mutex);
+	INIT_DELAYED_WORK(&priv->ext[0].dom_work, xeth_port_dom_work);
+	INIT_DELAYED_WORK(&priv->ext[0].probe_work, xeth_port_qsfp_probe_work);
+	INIT_WORK(&priv->ext[0].qsfp_work, xeth_port_qsfp_work);
+	xeth_qsfp_cache_init(&priv->ext[0].qsfp_cache);
 
 	if (data && data[XETH_PORT_IFLA_XID])
 		priv->proxy.xid = nla_get_u16(data[XETH_PORT_IFLA_XID]);
@@ -661,7 +1040,8 @@ static const struct nla_policy xeth_port_nla_policy[] = {
 
 struct rtnl_link_ops xeth_port_lnko = {
 	.kind		= xeth_port_drvname,
-	.priv_size	= sizeof(struct xeth_port_priv),
+	.priv_size	= sizeof(struct xeth_port_priv) +
+			  sizeof(struct xeth_port_ext),
 	.setup		= xeth_port_setup,
 	.validate	= xeth_port_validate,
 	.newlink	= xeth_port_newlink,
@@ -715,7 +1095,7 @@ static int xeth_port(struct platform_device *pd, struct net_device *mux,
 	struct net_device *nd;
 	struct xeth_port_priv *priv;
 	size_t sz;
-	int i, err;
+	int err;
 
 	sz = sizeof(*priv);
 	if (subport <= 0)
@@ -747,12 +1127,17 @@ static int xeth_port(struct platform_device *pd, struct net_device *mux,
 	priv->subport = subport;
 
 	if (subport <= 0) {
-		u8 bus = xeth_port_qsfp_bus_prop(pd);
 		nd->ethtool_ops = &xeth_port_eto;
-		for (i = 0; i < ARRAY_SIZE(priv->ext[0].stats); i++)
-			atomic64_set(&priv->ext[0].stats[i], 0LL);
-		if (bus)
-			xeth_port_qsfp(priv, bus);
+		seqlock_init(&priv->ext[0].stats_lock);
+		mutex_init(&priv->ext[0].qsfp_mutex);
+		INIT_DELAYED_WORK(&priv->ext[0].dom_work, xeth_port_dom_work);
+		INIT_DELAYED_WORK(&priv->ext[0].probe_work,
+				  xeth_port_qsfp_probe_work);
+		INIT_WORK(&priv->ext[0].qsfp_work, xeth_port_qsfp_work);
+		xeth_qsfp_cache_init(&priv->ext[0].qsfp_cache);
+		RCU_INIT_POINTER(priv->ext[0].stats,
+				 xeth_port_stats_alloc(xeth_mux_n_stats(mux)));
+		priv->ext[0].qsfp_bus = xeth_port_qsfp_bus_prop(pd);
 	} else
 		nd->ethtool_ops = &xeth_subport_eto;
 
@@ -770,7 +1155,8 @@ static int xeth_port(struct platform_device *pd, struct net_device *mux,
 	if (err) {
 		xeth_mux_del_proxy(&priv->proxy);
 		free_netdev(nd);
-	}
+	} else if (subport <= 0 && priv->ext[0].qsfp_bus)
+		queue_work(system_unbound_wq, &priv->ext[0].qsfp_work);
 	return err;
 }
 
@@ -13,6 +13,7 @@
 #include <linux/netdevice.h>
 #include <linux/platform_device.h>
 #include <linux/i2c.h>
+#include <linux/interrupt.h>
 
 extern struct platform_driver xeth_port_driver;
 extern struct rtnl_link_ops xeth_port_lnko;
@@ -30,7 +31,8 @@ int xeth_port_subport(struct net_device *nd);
 u32 xeth_port_ethtool_priv_flags(struct net_device *nd);
 const struct ethtool_link_ksettings *
 	xeth_port_ethtool_ksettings(struct net_device *nd);
-void xeth_port_ethtool_stat(struct net_device *nd, u32 index, u64 count);
+void xeth_port_ethtool_stats(struct net_device *nd, u32 first, u32 n,
+			     const u64 *count, u64 time);
 void xeth_port_link_stat(struct net_device *nd, u32 index, u64 count);
 void xeth_port_speed(struct net_device *nd, u32 mbps);
 
@@ -13,6 +13,21 @@
 #include "xeth_sbtx.h"
 #include "xeth_debug.h"
 
+static uint xeth_proxy_stats_age = 1000;
+
+module_param_named(stats_age, xeth_proxy_stats_age, uint, 0644);
+MODULE_PARM_DESC(stats_age, " ms before stats read are pulled from controllers "
+		 "with the capability, 0 to never pull");
+
+/* An ethtool reader holds rtnl, so each ms of this may be paid by every
+ * port of a dump and by all else that needs rtnl meanwhile.
+ */
+static uint xeth_proxy_stats_wait;
+
+module_param_named(stats_wait, xeth_proxy_stats_wait, uint, 0644);
+MODULE_PARM_DESC(stats_wait, " ms an ethtool reader waits, with rtnl held, "
+		 "for pulled stats; 0 (default) for the cached counts");
+
 void xeth_proxy_dump_ifa(struct xeth_proxy *proxy)
 {
 	struct in_ifaddr *ifa;
@@ -69,17 +84,126 @@ void xeth_proxy_dump_ifinfo(struct xeth_proxy *proxy)
 	}
 }
 
-void xeth_proxy_link_stat(struct net_device *nd, u32 index, u64 count)
+/* Set @n counts from XETH_LINK_STAT_* @first as one update, sampled at
+ * @time unless 0.
+ */
+void xeth_proxy_link_stats(struct net_device *nd, u32 first, u32 n,
+			   const u64 *count, u64 time)
 {
 	struct xeth_proxy *proxy = netdev_priv(nd);
-	if (index < XETH_N_LINK_STAT)
-		atomic64_set(&proxy->link_stats[index], count);
-	else
+
+	if (first >= XETH_N_LINK_STAT || n > XETH_N_LINK_STAT - first) {
 		xeth_mux_inc_sbrx_invalid(proxy->mux);
+		return;
+	}
+	write_seqlock_bh(&proxy->link_stats_lock);
+	memcpy(&proxy->link_stats[first], count, n * sizeof(*count));
+	if (time)
+		proxy->link_stats_time = time;
+	write_sequnlock_bh(&proxy->link_stats_lock);
+}
+
+u64 xeth_proxy_link_stats_time(struct net_device *nd)
+{
+	struct xeth_proxy *proxy = netdev_priv(nd);
+	unsigned seq;
+	u64 time;
+
+	do {
+		seq = read_seqbegin(&proxy->link_stats_lock);
+		time = proxy->link_stats_time;
+	} while (read_seqretry(&proxy->link_stats_lock, seq));
+	return time;
+}
+
+/* return the @stats mask of those older than stats_age */
+static u32 xeth_proxy_stale_stats(struct xeth_proxy *proxy, u32 stats)
+{
+	unsigned long age = msecs_to_jiffies(xeth_proxy_stats_age);
+	u32 stale = 0;
+	int bit;
+
+	for (bit = 0; bit < XETH_N_STATS_REQUESTS; bit++)
+		if ((stats & BIT(bit)) &&
+		    !time_before(jiffies, READ_ONCE(proxy->stats_at[bit]) + age))
+			stale |= BIT(bit);
+	return stale;
+}
+
+static void xeth_proxy_stats_work(struct work_struct *work)
+{
+	struct xeth_proxy *proxy =
+		container_of(work, struct xeth_proxy, stats_work);
+	u32 stats = atomic_xchg(&proxy->stats_want, 0);
+
+	if (stats)
+		xeth_sbtx_stats_request(proxy->mux, proxy->xid, stats);
+}
+
+/**
+ * xeth_proxy_pull_stats() - request stale stats from the controller
+ * @stats: bitmask of XETH_STATS_REQUEST_*
+ * @wait: up to stats_wait, if set, for the refresh; only from process
+ *	context
+ *
+ * This does nothing unless the synced controllers send stats on request
+ * rather than stream them. A request is sent by work, at most once per
+ * stats_age, so that ndo_get_stats64() may call this in atomic context.
+ */
+void xeth_proxy_pull_stats(struct net_device *nd, u32 stats, bool wait)
+{
+	struct xeth_proxy *proxy = netdev_priv(nd);
+	unsigned long age = msecs_to_jiffies(xeth_proxy_stats_age);
+	u32 stale, want = 0;
+	int bit;
+
+	if (!xeth_proxy_stats_age || !proxy->mux || !proxy->xid ||
+	    !(xeth_mux_caps(proxy->mux) & XETH_CAP_STATS_PULL))
+		return;
+	stale = xeth_proxy_stale_stats(proxy, stats);
+	if (!stale)
+		return;
+	for (bit = 0; bit < XETH_N_STATS_REQUESTS; bit++)
+		if ((stale & BIT(bit)) &&
+		    !time_before(jiffies,
+				 READ_ONCE(proxy->stats_asked[bit]) + age)) {
+			WRITE_ONCE(proxy->stats_asked[bit], jiffies);
+			want |= BIT(bit);
+		}
+	if (want) {
+		atomic_or(want, &proxy->stats_want);
+		schedule_work(&proxy->stats_work);
+	}
+	if (wait && xeth_proxy_stats_wait)
+		wait_event_interruptible_timeout(proxy->stats_wq,
+			!xeth_proxy_stale_stats(proxy, stale),
+			msecs_to_jiffies(xeth_proxy_stats_wait));
+}
+
+/* The controller echoes STATS_REQUEST after the requested stats. */
+void xeth_proxy_stats_done(struct net_device *nd, u32 stats)
+{
+	struct xeth_proxy *proxy = netdev_priv(nd);
+	int bit;
+
+	for (bit = 0; bit < XETH_N_STATS_REQUESTS; bit++)
+		if (stats & BIT(bit))
+			WRITE_ONCE(proxy->stats_at[bit], jiffies);
+	wake_up_interruptible(&proxy->stats_wq);
 }
 
 int xeth_proxy_init(struct net_device *nd)
 {
+	struct xeth_proxy *proxy = netdev_priv(nd);
+	int bit;
+
+	INIT_WORK(&proxy->stats_work, xeth_proxy_stats_work);
+	init_waitqueue_head(&proxy->stats_wq);
+	/* as if last refreshed and requested at boot */
+	for (bit = 0; bit < XETH_N_STATS_REQUESTS; bit++) {
+		proxy->stats_at[bit] = INITIAL_JIFFIES;
+		proxy->stats_asked[bit] = INITIAL_JIFFIES;
+	}
 	nd->hw_features = NETIF_F_HW_L2FW_DOFFLOAD;
 	nd->features |= NETIF_F_VLAN_CHALLENGED;
 	nd->features &= ~NETIF_F_SOFT_FEATURES;
@@ -91,6 +215,7 @@ int xeth_proxy_init(struct net_device *nd)
 void xeth_proxy_uninit(struct net_device *nd)
 {
 	struct xeth_proxy *proxy = netdev_priv(nd);
+	cancel_work_sync(&proxy->stats_work);
 	xeth_sbtx_ifinfo(proxy, 0, XETH_IFINFO_REASON_DEL);
 	xeth_mux_del_proxy(proxy);
 }
@@ -126,7 +251,16 @@ void xeth_proxy_get_stats64(struct net_device *nd,
 			    struct rtnl_link_stats64 *dst)
 {
 	struct xeth_proxy *proxy = netdev_priv(nd);
-	xeth_link_stats(dst, proxy->link_stats);
+	u64 t[XETH_N_LINK_STAT];
+	unsigned seq;
+
+	xeth_proxy_pull_stats(nd, XETH_STATS_REQUEST_LINK, false);
+	do {
+		seq = read_seqbegin(&proxy->link_stats_lock);
+		memcpy(t, proxy->link_stats, sizeof(t));
+	} while (read_seqretry(&proxy->link_stats_lock, seq));
+	t[XETH_LINK_STAT_TX_DROPPED] += atomic64_read(&proxy->tx_dropped);
+	xeth_link_stats64(dst, t);
 }
 
 int xeth_proxy_change_mtu(struct net_device *nd, int mtu)
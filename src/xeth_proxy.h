@@ -12,6 +12,7 @@
 
 #include "xeth_link_stat.h"
 #include <linux/netdevice.h>
+#include <linux/seqlock.h>
 
 /**
  * struct xeth_proxy -	first member of each xeth proxy device priv
@@ -25,9 +26,28 @@ struct xeth_proxy {
 	struct list_head __rcu	kin;
 	/* @quit: pending quit from lag or bridge */
 	struct list_head quit;
-	atomic64_t link_stats[XETH_N_LINK_STAT];
+	/* @link_stats_lock: writers of @link_stats and its sample time, by
+	 * the controller, so that readers see the counts of whole updates
+	 */
+	seqlock_t link_stats_lock;
+	u64 link_stats[XETH_N_LINK_STAT];
+	u64 link_stats_time;
+	/* @tx_dropped: by the mux, in addition to those of the controller */
+	atomic64_t tx_dropped;
+	/* @stats_work: sends STATS_REQUEST of @stats_want */
+	struct work_struct stats_work;
+	atomic_t stats_want;
+	/* @stats_wq: ethtool readers waiting for a refresh */
+	wait_queue_head_t stats_wq;
+	/* @stats_at, @stats_asked: jiffies of the last refresh and request
+	 * of each XETH_STATS_REQUEST_*
+	 */
+	unsigned long stats_at[XETH_N_STATS_REQUESTS];
+	unsigned long stats_asked[XETH_N_STATS_REQUESTS];
 	enum xeth_dev_kind kind;
 	u32 xid;
+	/* @stale: port carrier held over a controller restart */
+	bool stale;
 };
 
 #define xeth_proxy_of_kin(ptr)						\
@@ -49,14 +69,21 @@ void xeth_proxy_dump_ifinfo(struct xeth_proxy *);
 
 static inline void xeth_proxy_reset_link_stats(struct xeth_proxy *proxy)
 {
-	xeth_link_stat_init(proxy->link_stats);
+	write_seqlock_bh(&proxy->link_stats_lock);
+	memset(proxy->link_stats, 0, sizeof(proxy->link_stats));
+	proxy->link_stats_time = 0;
+	write_sequnlock_bh(&proxy->link_stats_lock);
+	atomic64_set(&proxy->tx_dropped, 0LL);
 }
 
 static inline void xeth_proxy_setup(struct net_device *nd)
 {
 	struct xeth_proxy *proxy = netdev_priv(nd);
 	INIT_LIST_HEAD(&proxy->kin);
-	xeth_link_stat_init(proxy->link_stats);
+	seqlock_init(&proxy->link_stats_lock);
+	memset(proxy->link_stats, 0, sizeof(proxy->link_stats));
+	proxy->link_stats_time = 0;
+	atomic64_set(&proxy->tx_dropped, 0LL);
 }
 
 int xeth_proxy_init(struct net_device *nd);
@@ -66,7 +93,11 @@ int xeth_proxy_stop(struct net_device *nd);
 netdev_tx_t xeth_proxy_start_xmit(struct sk_buff *skb, struct net_device *nd);
 int xeth_proxy_get_iflink(const struct net_device *nd);
 int xeth_proxy_change_mtu(struct net_device *nd, int mtu);
-void xeth_proxy_link_stat(struct net_device *nd, u32 index, u64 count);
+void xeth_proxy_link_stats(struct net_device *nd, u32 first, u32 n,
+			   const u64 *count, u64 time);
+u64 xeth_proxy_link_stats_time(struct net_device *nd);
+void xeth_proxy_pull_stats(struct net_device *nd, u32 stats, bool wait);
+void xeth_proxy_stats_done(struct net_device *nd, u32 stats);
 void xeth_proxy_get_stats64(struct net_device *, struct rtnl_link_stats64 *);
 netdev_features_t xeth_proxy_fix_features(struct net_device *,
 					  netdev_features_t);
@@ -8,12 +8,24 @@
  */
 
 #include "xeth_qsfp.h"
-#include <linux/mutex.h>
 
-static DEFINE_MUTEX(xeth_qsfp_mutex);
-
-static void xeth_qsfp_lock(void)	{ mutex_lock(&xeth_qsfp_mutex); }
-static void xeth_qsfp_unlock(void)	{ mutex_unlock(&xeth_qsfp_mutex); }
+const char xeth_qsfp_dom_stat_names[][ETH_GSTRING_LEN] = {
+	"module_temperature_mK",
+	"module_vcc_uV",
+	"module_rx_power_nW_0",
+	"module_rx_power_nW_1",
+	"module_rx_power_nW_2",
+	"module_rx_power_nW_3",
+	"module_tx_bias_uA_0",
+	"module_tx_bias_uA_1",
+	"module_tx_bias_uA_2",
+	"module_tx_bias_uA_3",
+	"module_tx_power_nW_0",
+	"module_tx_power_nW_1",
+	"module_tx_power_nW_2",
+	"module_tx_power_nW_3",
+	"module_dom_time_ns",
+};
 
 static int xeth_qsfp_peek(struct i2c_adapter *adapter, unsigned short addr)
 {
@@ -38,18 +50,48 @@ static int xeth_qsfp_peek(struct i2c_adapter *adapter, unsigned short addr)
 	return data.byte;
 }
 
+/* Read up to I2C_SMBUS_BLOCK_MAX bytes; call with the bus held. */
+static int xeth_qsfp_block(struct i2c_client *qsfp, u8 *data, u32 o, u32 n)
+{
+	union i2c_smbus_data block;
+	int err;
+
+	block.block[0] = min_t(u32, n, I2C_SMBUS_BLOCK_MAX);
+	err = __i2c_smbus_xfer(qsfp->adapter, qsfp->addr, qsfp->flags,
+			       I2C_SMBUS_READ, o, I2C_SMBUS_I2C_BLOCK_DATA,
+			       &block);
+	if (err < 0)
+		return err;
+	memcpy(data, &block.block[1], block.block[0]);
+	return block.block[0];
+}
+
+/* Hold the module's bus, not others, through the SMBus reads so that
+ * another reader can't move the module's address pointer between them.
+ * Read in blocks if the adapter can, otherwise, or if a block fails, by
+ * bytes.
+ */
 static int xeth_qsfp_bload(struct i2c_client *qsfp, u8 *data, u32 o, u32 n)
 {
-	int i;
+	bool blocks = i2c_check_functionality(qsfp->adapter,
+					      I2C_FUNC_SMBUS_READ_I2C_BLOCK);
+	union i2c_smbus_data byte;
+	int i, r;
 
-	xeth_qsfp_lock();
-	for (i = 0; i < n; i++) {
-		s32 r = i2c_smbus_read_byte_data(qsfp, o + i);
-		if (r < 0)
+	i2c_lock_bus(qsfp->adapter, I2C_LOCK_SEGMENT);
+	for (i = 0; i < n; i += r) {
+		r = blocks ? xeth_qsfp_block(qsfp, data + i, o + i, n - i) : 0;
+		if (r > 0)
+			continue;
+		blocks = false;
+		if (__i2c_smbus_xfer(qsfp->adapter, qsfp->addr, qsfp->flags,
+				     I2C_SMBUS_READ, o + i,
+				     I2C_SMBUS_BYTE_DATA, &byte) < 0)
 			break;
-		data[i] = r;
+		data[i] = byte.byte;
+		r = 1;
 	}
-	xeth_qsfp_unlock();
+	i2c_unlock_bus(qsfp->adapter, I2C_LOCK_SEGMENT);
 	return i;
 }
 
@@ -71,11 +113,8 @@ static int xeth_qsfp_xload(struct i2c_client *qsfp, u8 *data, u32 o, u32 n)
 		},
 	};
 	int nmsgs = ARRAY_SIZE(msgs);
-	int err;
-
-	xeth_qsfp_lock();
-	err = i2c_transfer(qsfp->adapter, msgs, nmsgs);
-	xeth_qsfp_unlock();
+	/* the core holds the bus through the combined transfer */
+	int err = i2c_transfer(qsfp->adapter, msgs, nmsgs);
 
 	return err < 0 ? err : err == nmsgs ? n : 0;
 }
@@ -87,18 +126,144 @@ static int xeth_qsfp_load(struct i2c_client *qsfp, u8 *data, u32 o, u32 n)
 		xeth_qsfp_bload(qsfp, data, o, n);
 }
 
+/* Load the cache unless it's current; call with the port's qsfp mutex. */
+int xeth_qsfp_cache_load(struct i2c_client *qsfp,
+				struct xeth_qsfp_cache *cache)
+{
+	int gen = atomic_read(&cache->gen);
+	int n;
+
+	if (cache->loaded == gen)
+		return 0;
+	n = xeth_qsfp_load(qsfp, cache->eeprom, 0, sizeof(cache->eeprom));
+	if (n < 0)
+		return n;
+	if (n != sizeof(cache->eeprom))
+		return -EIO;
+	/* stays stale if invalidated while loading */
+	cache->loaded = gen;
+	return 0;
+}
+
+/* Return the end of the range of bytes from @o that are all read from the
+ * module, if @live, or else all from the cache.
+ */
+static u32 xeth_qsfp_range(struct xeth_qsfp_cache *cache, u32 o, bool *live)
+{
+	bool dom = cache->dom_loaded == atomic_read(&cache->gen);
+
+	*live = true;
+	if (o >= xeth_qsfp_cached_eeprom)
+		return U32_MAX;
+	if (cache->eeprom[0] != 0x03) {	/* QSFP lower page */
+		if (o >= 2 && o < xeth_qsfp_dom_offset)
+			return dom ? xeth_qsfp_dom_offset : 128;
+		if (o >= xeth_qsfp_dom_offset && o < xeth_qsfp_dom_end) {
+			if (!dom)
+				return 128;
+			*live = false;
+			return xeth_qsfp_dom_end;
+		}
+		if (o >= xeth_qsfp_dom_end && o < 128)
+			return 128;
+		if (o < 2) {
+			*live = false;
+			return 2;
+		}
+	}
+	*live = false;
+	return xeth_qsfp_cached_eeprom;
+}
+
+/**
+ * xeth_qsfp_dom_sample() - read the monitors of a QSFP into its cache
+ * @flags: if not NULL, also read the latched flags here, clearing them
+ *
+ * Call with the port's qsfp mutex. The flags and monitors are adjacent
+ * so both are read in one transfer.
+ */
+int xeth_qsfp_dom_sample(struct i2c_client *qsfp,
+			 struct xeth_qsfp_cache *cache, u8 *flags)
+{
+	u8 buf[xeth_qsfp_dom_end - 3];
+	u32 o = flags ? 3 : xeth_qsfp_dom_offset;
+	u32 n = xeth_qsfp_dom_end - o;
+	int gen = atomic_read(&cache->gen);
+	int err;
+
+	err = xeth_qsfp_cache_load(qsfp, cache);
+	if (err < 0)
+		return err;
+	if (cache->eeprom[0] == 0x03)	/* SFP monitors are at another addr */
+		return -EOPNOTSUPP;
+	err = xeth_qsfp_load(qsfp, buf, o, n);
+	if (err < 0)
+		return err;
+	if (err != n)
+		return -EIO;
+	if (flags)
+		memcpy(flags, buf, xeth_qsfp_n_flags);
+	memcpy(&cache->eeprom[xeth_qsfp_dom_offset],
+	       &buf[xeth_qsfp_dom_offset - o],
+	       xeth_qsfp_dom_end - xeth_qsfp_dom_offset);
+	cache->dom_time = ktime_get_real_ns();
+	cache->dom_loaded = gen;
+	return 0;
+}
+
+static u16 xeth_qsfp_u16(struct xeth_qsfp_cache *cache, u32 o)
+{
+	return (cache->eeprom[o] << 8) | cache->eeprom[o + 1];
+}
+
+/* Decode the sampled monitors, in the order of xeth_qsfp_dom_stat_names,
+ * or zeros if there isn't a current sample; call with the port's qsfp mutex.
+ */
+void xeth_qsfp_dom_stats(struct xeth_qsfp_cache *cache, u64 *data)
+{
+	int lane;
+
+	if (cache->dom_loaded != atomic_read(&cache->gen)) {
+		memset(data, 0, xeth_qsfp_n_dom_stats * sizeof(*data));
+		return;
+	}
+	/* signed 1/256 C, as mK so that the u64 stat is never negative */
+	*data++ = ((s32)(s16)xeth_qsfp_u16(cache, 22) * 1000 / 256) + 273150;
+	/* 100 uV */
+	*data++ = (u64)xeth_qsfp_u16(cache, 26) * 100;
+	/* 0.1 uW */
+	for (lane = 0; lane < 4; lane++)
+		*data++ = (u64)xeth_qsfp_u16(cache, 34 + (2 * lane)) * 100;
+	/* 2 uA */
+	for (lane = 0; lane < 4; lane++)
+		*data++ = (u64)xeth_qsfp_u16(cache, 42 + (2 * lane)) * 2;
+	/* 0.1 uW */
+	for (lane = 0; lane < 4; lane++)
+		*data++ = (u64)xeth_qsfp_u16(cache, 50 + (2 * lane)) * 100;
+	*data = cache->dom_time;
+}
+
+/* Read the latched QSFP interrupt flags, lower page bytes 3 through 21,
+ * which clears them.
+ */
+int xeth_qsfp_get_flags(struct i2c_client *qsfp, u8 *flags)
+{
+	int n = xeth_qsfp_load(qsfp, flags, 3, xeth_qsfp_n_flags);
+
+	return n < 0 ? n : n == xeth_qsfp_n_flags ? 0 : -EIO;
+}
+
 int xeth_qsfp_get_module_info(struct i2c_client *qsfp,
+			      struct xeth_qsfp_cache *cache,
 			      struct ethtool_modinfo *emi)
 {
-	u8 b[2];
-	u32 n = ARRAY_SIZE(b);
+	u8 *b = cache->eeprom;
 	int err;
 
-	/* Read first 2 bytes to get Module & REV ID */
-	err = xeth_qsfp_load(qsfp, b, 0, n);
+	/* Module & REV ID */
+	err = xeth_qsfp_cache_load(qsfp, cache);
 	if (err < 0)
 		return err;
-	err = 0;
 	switch (b[0]) {
 	case 0x03:	/* SFP    */
 		emi->type = ETH_MODULE_SFF_8472;
@@ -128,16 +293,31 @@ int xeth_qsfp_get_module_info(struct i2c_client *qsfp,
 }
 
 int xeth_qsfp_get_module_eeprom(struct i2c_client *qsfp,
+				struct xeth_qsfp_cache *cache,
 				struct ethtool_eeprom *ee, u8 *data)
 {
+	u32 o = ee->offset, end = ee->offset + ee->len, n;
+	bool live;
 	int err;
 
 	if (ee->cmd != ETHTOOL_GMODULEEEPROM)
 		return -EOPNOTSUPP;
 	if (!ee->len)
 		return -EINVAL;
-	err = xeth_qsfp_load(qsfp, data, ee->offset, ee->len);
-	return err < 0 ? err : 0;
+	err = xeth_qsfp_cache_load(qsfp, cache);
+	if (err < 0)
+		return err;
+	for (; o < end; o += n, data += n) {
+		n = min(xeth_qsfp_range(cache, o, &live), end) - o;
+		if (!live) {
+			memcpy(data, &cache->eeprom[o], n);
+			continue;
+		}
+		err = xeth_qsfp_load(qsfp, data, o, n);
+		if (err < 0)
+			return err;
+	}
+	return 0;
 }
 
 struct i2c_client *xeth_qsfp_client(int nr, const unsigned short const *addrs)
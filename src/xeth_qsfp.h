@@ -10,12 +10,65 @@
 #ifndef __NET_ETHERNET_XETH_QSFP_H
 #define __NET_ETHERNET_XETH_QSFP_H
 
+#include <linux/atomic.h>
 #include <linux/ethtool.h>
 #include <linux/i2c.h>
+#include <linux/timekeeping.h>
 
+enum {
+	xeth_qsfp_cached_eeprom = 256,
+	xeth_qsfp_n_flags = 19,
+	/* QSFP lower page monitors: temperature through lane tx power */
+	xeth_qsfp_dom_offset = 22,
+	xeth_qsfp_dom_end = 58,
+	xeth_qsfp_n_dom_stats = 15,
+};
+
+extern const char xeth_qsfp_dom_stat_names[][ETH_GSTRING_LEN];
+
+/**
+ * struct xeth_qsfp_cache - static EEPROM bytes of a module
+ * @gen: incremented by each invalidation
+ * @loaded: @gen of the @eeprom bytes
+ * @dom_loaded: @gen of the monitor bytes last sampled
+ * @dom_time: ktime_get_real_ns() of that sample, like the port's other
+ *	stat times
+ *
+ * This has the lower page and upper page 00h; the volatile status and
+ * flags of a QSFP lower page are always read from the module, as are its
+ * monitors unless sampled since the last invalidation.
+ */
+struct xeth_qsfp_cache {
+	atomic_t gen;
+	int loaded, dom_loaded;
+	u64 dom_time;
+	u8 eeprom[xeth_qsfp_cached_eeprom];
+};
+
+static inline void xeth_qsfp_cache_init(struct xeth_qsfp_cache *cache)
+{
+	atomic_set(&cache->gen, 0);
+	cache->loaded = -1;
+	cache->dom_loaded = -1;
+}
+
+/* Call on module insertion or removal; safe in any context. */
+static inline void xeth_qsfp_invalidate(struct xeth_qsfp_cache *cache)
+{
+	atomic_inc(&cache->gen);
+}
+
+int xeth_qsfp_cache_load(struct i2c_client *qsfp,
+			 struct xeth_qsfp_cache *cache);
+int xeth_qsfp_get_flags(struct i2c_client *qsfp, u8 *flags);
+int xeth_qsfp_dom_sample(struct i2c_client *qsfp,
+			 struct xeth_qsfp_cache *cache, u8 *flags);
+void xeth_qsfp_dom_stats(struct xeth_qsfp_cache *cache, u64 *data);
 int xeth_qsfp_get_module_info(struct i2c_client *qsfp,
+			      struct xeth_qsfp_cache *cache,
 			      struct ethtool_modinfo *emi);
 int xeth_qsfp_get_module_eeprom(struct i2c_client *qsfp,
+				struct xeth_qsfp_cache *cache,
 				struct ethtool_eeprom *ee, u8 *data);
 /**
  * xeth_qsfp_client()
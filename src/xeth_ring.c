@@ -0,0 +1,309 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0
+ * Copyright(c) 2018-2020 Platina Systems, Inc.
+ *
+ * Contact Information:
+ * sw@platina.com
+ * Platina Systems, 3180 Del La Cruz Blvd, Santa Clara, CA 95054
+ */
+
+#include "xeth_ring.h"
+#include "xeth_mux.h"
+#include "xeth_debug.h"
+#include <linux/miscdevice.h>
+#include <linux/vmalloc.h>
+#include <linux/poll.h>
+#include <linux/kref.h>
+#include <linux/mm.h>
+
+/**
+ * struct xeth_ring_dev - the character device of a mux
+ *
+ * Each open of the device adds a side-band client of its own ring pair.
+ */
+struct xeth_ring_dev {
+	struct miscdevice misc;
+	struct net_device *mux;
+};
+
+/**
+ * struct xeth_ring - a pair of rings shared with a controller
+ * @tx: kernel to controller ring header, @txd its records
+ * @rx: controller to kernel ring header, @rxd its records
+ * @txhead, @rxtail: the kernel's counts; those in the shared headers are
+ *	only written, never trusted
+ * @wq: poll waiters
+ * @rxwq: the rx thread waiting for a kick
+ * @hungup: the mux dropped the client
+ * @closed: the controller released the device
+ *
+ * The rings are freed with the last reference of the file and client.
+ */
+struct xeth_ring {
+	struct kref kref;
+	void *mem;
+	struct xeth_ring_header *tx, *rx;
+	u8 *txd, *rxd;
+	u64 txhead, rxtail;
+	wait_queue_head_t wq, rxwq;
+	bool kicked, hungup, closed;
+};
+
+static inline size_t xeth_ring_record_size(size_t len)
+{
+	return ALIGN(sizeof(struct xeth_ring_record) + len, 8);
+}
+
+static struct xeth_ring *xeth_ring_alloc(void)
+{
+	struct xeth_ring *ring;
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return NULL;
+	ring->mem = vmalloc_user(XETH_RING_MMAP_SIZE);
+	if (!ring->mem) {
+		kfree(ring);
+		return NULL;
+	}
+	ring->tx = ring->mem;
+	ring->txd = (u8 *)ring->mem + XETH_RING_HEADER_SIZE;
+	ring->rx = ring->mem + XETH_RING_SIZE;
+	ring->rxd = (u8 *)ring->rx + XETH_RING_HEADER_SIZE;
+	ring->tx->size = XETH_RING_DATA_SIZE;
+	ring->rx->size = XETH_RING_DATA_SIZE;
+	kref_init(&ring->kref);
+	init_waitqueue_head(&ring->wq);
+	init_waitqueue_head(&ring->rxwq);
+	return ring;
+}
+
+static void xeth_ring_release(struct kref *kref)
+{
+	struct xeth_ring *ring = container_of(kref, struct xeth_ring, kref);
+
+	vfree(ring->mem);
+	kfree(ring);
+}
+
+struct xeth_ring *xeth_ring_get(struct xeth_ring *ring)
+{
+	kref_get(&ring->kref);
+	return ring;
+}
+
+void xeth_ring_put(struct xeth_ring *ring)
+{
+	kref_put(&ring->kref, xeth_ring_release);
+}
+
+/* The mux calls this as it drops the client. */
+void xeth_ring_hangup(struct xeth_ring *ring)
+{
+	WRITE_ONCE(ring->hungup, true);
+	wake_up_interruptible(&ring->wq);
+}
+
+/**
+ * xeth_ring_send() - copy a message to the kernel to controller ring
+ *
+ * Call only from the client's tx thread.
+ *
+ * Return: @len, -EAGAIN if full, -EPIPE if closed, or -EINVAL if the
+ * controller corrupted the ring.
+ */
+int xeth_ring_send(struct xeth_ring *ring, const void *data, size_t len)
+{
+	const u64 size = XETH_RING_DATA_SIZE;
+	size_t need = xeth_ring_record_size(len);
+	u64 head = ring->txhead;
+	u64 tail = smp_load_acquire(&ring->tx->tail);
+	u64 off = head & (size - 1);
+	struct xeth_ring_record *rec;
+
+	if (READ_ONCE(ring->closed))
+		return -EPIPE;
+	if (head - tail > size)
+		return -EINVAL;
+	if (off + need > size) {
+		if (size - (head - tail) < (size - off) + need)
+			return -EAGAIN;
+		rec = (struct xeth_ring_record *)(ring->txd + off);
+		rec->len = XETH_RING_WRAP;
+		head += size - off;
+		off = 0;
+	} else if (size - (head - tail) < need)
+		return -EAGAIN;
+	rec = (struct xeth_ring_record *)(ring->txd + off);
+	rec->len = len;
+	rec->reserved = 0;
+	memcpy(rec + 1, data, len);
+	ring->txhead = head + need;
+	smp_store_release(&ring->tx->head, ring->txhead);
+	wake_up_interruptible(&ring->wq);
+	return len;
+}
+
+/**
+ * xeth_ring_recv() - copy a message from the controller to kernel ring
+ *
+ * The message is copied out before it's checked so that the controller
+ * can't change it meanwhile. Call only from the client's rx thread.
+ *
+ * Return: the message length, -EAGAIN if empty, or -EINVAL if the
+ * controller corrupted the ring.
+ */
+int xeth_ring_recv(struct xeth_ring *ring, void *data, size_t max)
+{
+	const u64 size = XETH_RING_DATA_SIZE;
+	u64 tail = ring->rxtail;
+	u64 head = smp_load_acquire(&ring->rx->head);
+	u64 off = tail & (size - 1);
+	struct xeth_ring_record *rec;
+	size_t len, need;
+
+	if (head == tail)
+		return -EAGAIN;
+	if (head - tail > size)
+		return -EINVAL;
+	rec = (struct xeth_ring_record *)(ring->rxd + off);
+	len = READ_ONCE(rec->len);
+	if (len == XETH_RING_WRAP) {
+		tail += size - off;
+		if (head - tail > size || head == tail)
+			return -EINVAL;
+		off = 0;
+		rec = (struct xeth_ring_record *)ring->rxd;
+		len = READ_ONCE(rec->len);
+	}
+	need = xeth_ring_record_size(len);
+	if (len > max || off + need > size || need > head - tail)
+		return -EINVAL;
+	memcpy(data, rec + 1, len);
+	ring->rxtail = tail + need;
+	smp_store_release(&ring->rx->tail, ring->rxtail);
+	wake_up_interruptible(&ring->wq);
+	return len;
+}
+
+/* Wait up to 10 ms for a kick; return 1 if closed, otherwise 0. */
+int xeth_ring_wait_rx(struct xeth_ring *ring)
+{
+	wait_event_interruptible_timeout(ring->rxwq,
+		READ_ONCE(ring->kicked) || READ_ONCE(ring->closed),
+		msecs_to_jiffies(10));
+	WRITE_ONCE(ring->kicked, false);
+	return READ_ONCE(ring->closed) ? 1 : 0;
+}
+
+static int xeth_ring_open(struct inode *inode, struct file *file)
+{
+	struct xeth_ring_dev *dev =
+		container_of(file->private_data, struct xeth_ring_dev, misc);
+	struct xeth_ring *ring;
+	int err;
+
+	ring = xeth_ring_alloc();
+	if (!ring)
+		return -ENOMEM;
+	err = xeth_mux_add_ring(dev->mux, ring);
+	if (err) {
+		xeth_ring_put(ring);
+		return err;
+	}
+	file->private_data = ring;
+	return 0;
+}
+
+static int xeth_ring_release_file(struct inode *inode, struct file *file)
+{
+	struct xeth_ring *ring = file->private_data;
+
+	WRITE_ONCE(ring->closed, true);
+	wake_up(&ring->rxwq);
+	xeth_ring_put(ring);
+	return 0;
+}
+
+static int xeth_ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct xeth_ring *ring = file->private_data;
+
+	return remap_vmalloc_range(vma, ring->mem, vma->vm_pgoff);
+}
+
+static __poll_t xeth_ring_poll(struct file *file, poll_table *wait)
+{
+	struct xeth_ring *ring = file->private_data;
+	const u64 size = XETH_RING_DATA_SIZE;
+	__poll_t mask = 0;
+	u64 head, tail;
+
+	poll_wait(file, &ring->wq, wait);
+	if (READ_ONCE(ring->hungup))
+		mask |= EPOLLHUP;
+	if (READ_ONCE(ring->txhead) != smp_load_acquire(&ring->tx->tail))
+		mask |= EPOLLIN | EPOLLRDNORM;
+	head = smp_load_acquire(&ring->rx->head);
+	tail = READ_ONCE(ring->rxtail);
+	if (head - tail < size - xeth_ring_record_size(XETH_SIZEOF_JUMBO_FRAME))
+		mask |= EPOLLOUT | EPOLLWRNORM;
+	return mask;
+}
+
+static long xeth_ring_ioctl(struct file *file, unsigned int cmd,
+			    unsigned long arg)
+{
+	struct xeth_ring *ring = file->private_data;
+
+	switch (cmd) {
+	case XETH_RING_IOC_KICK:
+		WRITE_ONCE(ring->kicked, true);
+		wake_up(&ring->rxwq);
+		return 0;
+	}
+	return -ENOTTY;
+}
+
+static const struct file_operations xeth_ring_fops = {
+	.owner = THIS_MODULE,
+	.open = xeth_ring_open,
+	.release = xeth_ring_release_file,
+	.mmap = xeth_ring_mmap,
+	.poll = xeth_ring_poll,
+	.unlocked_ioctl = xeth_ring_ioctl,
+	.compat_ioctl = xeth_ring_ioctl,
+	.llseek = noop_llseek,
+};
+
+/* Register the device named like the mux; misc_deregister() waits out any
+ * open in progress, so unregister before stopping the mux clients.
+ */
+struct xeth_ring_dev *xeth_ring_register(struct net_device *mux)
+{
+	struct xeth_ring_dev *dev;
+	int err;
+
+	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	if (!dev)
+		return ERR_PTR(-ENOMEM);
+	dev->mux = mux;
+	dev->misc.minor = MISC_DYNAMIC_MINOR;
+	dev->misc.name = mux->name;
+	dev->misc.fops = &xeth_ring_fops;
+	dev->misc.mode = 0600;
+	err = misc_register(&dev->misc);
+	if (err) {
+		kfree(dev);
+		return ERR_PTR(err);
+	}
+	return dev;
+}
+
+void xeth_ring_unregister(struct xeth_ring_dev *dev)
+{
+	if (IS_ERR_OR_NULL(dev))
+		return;
+	misc_deregister(&dev->misc);
+	kfree(dev);
+}
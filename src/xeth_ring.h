@@ -0,0 +1,30 @@
+/**
+ * SPDX-License-Identifier: GPL-2.0
+ * Copyright(c) 2018-2020 Platina Systems, Inc.
+ *
+ * Contact Information:
+ * sw@platina.com
+ * Platina Systems, 3180 Del La Cruz Blvd, Santa Clara, CA 95054
+ */
+
+#ifndef __NET_ETHERNET_XETH_RING_H
+#define __NET_ETHERNET_XETH_RING_H
+
+#include "xeth.h"
+#include <linux/netdevice.h>
+
+struct xeth_ring;
+struct xeth_ring_dev;
+
+struct xeth_ring_dev *xeth_ring_register(struct net_device *mux);
+void xeth_ring_unregister(struct xeth_ring_dev *);
+
+struct xeth_ring *xeth_ring_get(struct xeth_ring *);
+void xeth_ring_put(struct xeth_ring *);
+void xeth_ring_hangup(struct xeth_ring *);
+
+int xeth_ring_send(struct xeth_ring *, const void *data, size_t len);
+int xeth_ring_recv(struct xeth_ring *, void *data, size_t max);
+int xeth_ring_wait_rx(struct xeth_ring *);
+
+#endif	/* __NET_ETHERNET_XETH_RING_H */
@@ -8,8 +8,12 @@
  */
 
 #include "xeth_mux.h"
+#include "xeth_fibdump.h"
+#include "xeth_genl.h"
 #include "xeth_nb.h"
+#include "xeth_neigh.h"
 #include "xeth_proxy.h"
+#include "xeth_ring.h"
 #include "xeth_sbrx.h"
 #include "xeth_sbtx.h"
 #include "xeth_port.h"
@@ -28,10 +32,11 @@ static void xeth_sbrx_carrier(struct net_device *mux,
 			      struct xeth_msg_carrier *msg)
 {
 	struct xeth_proxy *proxy = xeth_mux_proxy_of_xid(mux, msg->xid);
-	if (proxy && proxy->kind == XETH_DEV_KIND_PORT)
+	if (proxy && proxy->kind == XETH_DEV_KIND_PORT) {
+		proxy->stale = false;
 		xeth_mux_change_carrier(mux, proxy->nd,
 					msg->flag == XETH_CARRIER_ON);
-	else
+	} else
 		xeth_mux_inc_sbrx_invalid(mux);
 }
 
@@ -40,14 +45,54 @@ static void xeth_sbrx_et_stat(struct net_device *mux,
 {
 	struct xeth_proxy *proxy = xeth_mux_proxy_of_xid(mux, msg->xid);
 	if (proxy && proxy->kind == XETH_DEV_KIND_PORT)
-		xeth_port_ethtool_stat(proxy->nd, msg->index, msg->count);
+		xeth_port_ethtool_stats(proxy->nd, msg->index, 1,
+					&msg->count, 0);
 }
 
 static void xeth_sbrx_link_stat(struct net_device *mux,
 				struct xeth_msg_stat *msg)
 {
 	struct xeth_proxy *proxy = xeth_mux_proxy_of_xid(mux, msg->xid);
-	xeth_proxy_link_stat(proxy->nd, msg->index, msg->count);
+	if (proxy)
+		xeth_proxy_link_stats(proxy->nd, msg->index, 1,
+				      &msg->count, 0);
+	else
+		xeth_mux_inc_sbrx_invalid(mux);
+}
+
+static void xeth_sbrx_stats(struct net_device *mux,
+			    struct xeth_msg_stats *msg, size_t n)
+{
+	struct xeth_proxy *proxy;
+
+	if (n < sizeof(*msg) ||
+	    msg->n > (n - sizeof(*msg)) / sizeof(msg->count[0])) {
+		xeth_mux_inc_sbrx_invalid(mux);
+		return;
+	}
+	proxy = xeth_mux_proxy_of_xid(mux, msg->xid);
+	if (!proxy) {
+		xeth_mux_inc_sbrx_invalid(mux);
+		return;
+	}
+	if (msg->header.kind == XETH_MSG_KIND_LINK_STATS)
+		xeth_proxy_link_stats(proxy->nd, msg->first, msg->n,
+				      msg->count, msg->time);
+	else if (proxy->kind == XETH_DEV_KIND_PORT)
+		xeth_port_ethtool_stats(proxy->nd, msg->first, msg->n,
+					msg->count, msg->time);
+	else
+		xeth_mux_inc_sbrx_invalid(mux);
+}
+
+static void xeth_sbrx_stats_request(struct net_device *mux,
+				    struct xeth_msg_stats_request *msg)
+{
+	struct xeth_proxy *proxy = xeth_mux_proxy_of_xid(mux, msg->xid);
+	if (proxy)
+		xeth_proxy_stats_done(proxy->nd, msg->stats);
+	else
+		xeth_mux_inc_sbrx_invalid(mux);
 }
 
 static void xeth_sbrx_speed(struct net_device *mux,
@@ -58,27 +103,110 @@ static void xeth_sbrx_speed(struct net_device *mux,
 		xeth_port_speed(proxy->nd, msg->mbps);
 }
 
-// return < 0 if error, 1 if sock closed, and 0 othewise
-int xeth_sbrx(struct net_device *mux, struct socket *conn, void *data)
+static int xeth_sbrx_resync(struct xeth_mux_client *client,
+			    struct xeth_msg_seq *msg)
 {
-	struct xeth_msg_header *msg = data;
-	struct msghdr oob = {};
-	struct kvec iov = {
-		.iov_base = data,
-		.iov_len = XETH_SIZEOF_JUMBO_FRAME,
-	};
-	int n, err;
+	if (!client)
+		return -EINVAL;
+	xeth_mux_resync(client, msg->seq, msg->epoch);
+	return 0;
+}
 
-	xeth_mux_inc_sbrx_ticks(mux);
-	n = kernel_recvmsg(conn, &oob, &iov, 1, iov.iov_len, 0);
-	if (n == -EAGAIN) {
-		schedule();
-		return 0;
+static int xeth_sbrx_hello(struct xeth_mux_client *client,
+			   struct xeth_msg_hello *msg)
+{
+	if (!client)
+		return -EINVAL;
+	xeth_mux_hello(client, msg->kinds, msg->caps);
+	xeth_nb_update_fib_filter(client->mux);
+	return 0;
+}
+
+static int xeth_sbrx_subscribe(struct xeth_mux_client *client,
+			       struct xeth_msg_subscribe *msg)
+{
+	if (!client)
+		return -EINVAL;
+	xeth_mux_subscribe(client, msg->kinds);
+	xeth_nb_update_fib_filter(client->mux);
+	return 0;
+}
+
+static int xeth_sbrx_fib_filter(struct xeth_mux_client *client,
+				struct xeth_msg_fib_filter *msg, size_t n)
+{
+	int err;
+
+	if (!client)
+		return -EINVAL;
+	if (n < sizeof(*msg) ||
+	    msg->n > (n - sizeof(*msg)) / sizeof(msg->entries[0])) {
+		xeth_mux_inc_sbrx_invalid(client->mux);
+		return -EINVAL;
 	}
-	if (n == 0 || n == -ECONNRESET)
-		return 1;
-	if (n < 0)
-		return n;
+	err = xeth_mux_set_fib_filter(client, msg->entries, msg->n);
+	if (!xeth_debug_err(err))
+		xeth_nb_update_fib_filter(client->mux);
+	return err;
+}
+
+/**
+ * xeth_sbrx_dump_ifinfo() - send the netns and interfaces to a dump's
+ * requester
+ *
+ * The first dump starts the notifiers, whose replay of the registered
+ * netdevs sends each netns by its loopback; later dumps leave them running
+ * for other clients and send those themselves. rtnl keeps a live change
+ * from being logged between the read of what it changes and its dump.
+ *
+ * Call while dumping.
+ */
+static void xeth_sbrx_dump_ifinfo(struct net_device *mux)
+{
+	if (!xeth_mux_has_inetaddr_notifier(mux))
+		xeth_debug_err(xeth_nb_start_inetaddr(mux));
+	if (!xeth_mux_has_netdevice_notifier(mux))
+		xeth_debug_err(xeth_nb_start_netdevice(mux));
+	else
+		xeth_mux_dump_all_netns(mux);
+	rtnl_lock();
+	xeth_mux_dump_all_ifinfo(mux);
+	rtnl_unlock();
+}
+
+/**
+ * xeth_sbrx_dump_fibinfo() - send the routes, their nexthop objects and the
+ * neighbours to a dump's requester
+ * @compact: encode the routes as FIBDUMP, if there's memory to
+ *
+ * The first dump starts the notifiers, whose registration replays the FIB;
+ * later dumps replay it by another notifier, leaving the live one for
+ * other clients.
+ *
+ * Call while dumping.
+ */
+static void xeth_sbrx_dump_fibinfo(struct net_device *mux, bool compact)
+{
+	if (!xeth_mux_has_netevent_notifier(mux))
+		xeth_debug_err(xeth_nb_start_netevent(mux));
+	xeth_neigh_dump(mux);
+	if (compact && xeth_debug_err(xeth_fibdump_begin(mux)))
+		compact = false;
+	if (!xeth_mux_has_fib_notifier(mux))
+		xeth_debug_err(xeth_nb_start_fib(mux));
+	else
+		xeth_debug_err(xeth_nb_dump_fib(mux));
+	if (compact)
+		xeth_fibdump_end(mux);
+}
+
+/* Process a message received by any transport. */
+static int xeth_sbrx_msg(struct net_device *mux, struct xeth_mux_client *client,
+			 void *data, size_t n)
+{
+	struct xeth_msg_header *msg = data;
+	int err = 0;
+
 	xeth_mux_inc_sbrx_msgs(mux);
 	if (n < sizeof(*msg) || !xeth_sbrx_is_msg(msg))
 		return -EINVAL;
@@ -86,31 +214,117 @@ int xeth_sbrx(struct net_device *mux, struct socket *conn, void *data)
 		return -EINVAL;
 	switch (msg->kind) {
 	case XETH_MSG_KIND_DUMP_IFINFO:
-		xeth_mux_dump_all_ifinfo(mux);
-		xeth_sbtx_break(mux);
-		xeth_debug_err(xeth_nb_start_netdevice(mux));
-		xeth_debug_err(xeth_nb_start_inetaddr(mux));
+		/* notifiers may still run from a journaled earlier session;
+		 * other clients and genl may request a dump meanwhile
+		 */
+		xeth_mux_lock_dump(mux, client);
+		xeth_mux_sync(client);
+		xeth_sbrx_dump_ifinfo(mux);
+		xeth_sbtx_break(mux, false);
+		xeth_mux_unlock_dump(mux);
 		break;
 	case XETH_MSG_KIND_DUMP_FIBINFO:
-		xeth_debug_err(xeth_nb_start_fib(mux));
-		xeth_sbtx_break(mux);
-		xeth_debug_err(xeth_nb_start_netevent(mux));
+		xeth_mux_lock_dump(mux, client);
+		xeth_mux_sync(client);
+		xeth_sbrx_dump_fibinfo(mux, false);
+		xeth_sbtx_break(mux, true);
+		xeth_mux_unlock_dump(mux);
+		break;
+	case XETH_MSG_KIND_DUMP_FIBINFO_COMPACT:
+		xeth_mux_lock_dump(mux, client);
+		xeth_mux_sync(client);
+		/* fall back to DUMP_FIBINFO unless the requester understands
+		 * the encoding
+		 */
+		xeth_sbrx_dump_fibinfo(mux, xeth_mux_client_caps(client) &
+				       XETH_CAP_FIBDUMP_COMPACT);
+		xeth_sbtx_break(mux, true);
+		xeth_mux_unlock_dump(mux);
+		break;
+	case XETH_MSG_KIND_RESYNC:
+		err = xeth_sbrx_resync(client, data);
+		break;
+	case XETH_MSG_KIND_SUBSCRIBE:
+		err = xeth_sbrx_subscribe(client, data);
+		break;
+	case XETH_MSG_KIND_HELLO:
+		err = xeth_sbrx_hello(client, data);
+		break;
+	case XETH_MSG_KIND_FIB_FILTER:
+		err = xeth_sbrx_fib_filter(client, data, n);
 		break;
 	case XETH_MSG_KIND_CARRIER:
 		xeth_sbrx_carrier(mux, data);
+		xeth_genl_event(mux, data, n);
 		break;
 	case XETH_MSG_KIND_ETHTOOL_STAT:
 		xeth_sbrx_et_stat(mux, data);
+		xeth_genl_event(mux, data, n);
 		break;
 	case XETH_MSG_KIND_LINK_STAT:
 		xeth_sbrx_link_stat(mux, data);
+		xeth_genl_event(mux, data, n);
+		break;
+	case XETH_MSG_KIND_LINK_STATS:
+	case XETH_MSG_KIND_ETHTOOL_STATS:
+		xeth_sbrx_stats(mux, data, n);
+		xeth_genl_event(mux, data, n);
+		break;
+	case XETH_MSG_KIND_STATS_REQUEST:
+		xeth_sbrx_stats_request(mux, data);
 		break;
 	case XETH_MSG_KIND_SPEED:
 		xeth_sbrx_speed(mux, data);
+		xeth_genl_event(mux, data, n);
 		break;
 	default:
 		xeth_mux_inc_sbrx_invalid(mux);
 		err = -EINVAL;
 	}
-	return 0;
+	/* a client isn't dropped for a message it may not send */
+	return client ? 0 : err;
+}
+
+/* A message by the generic netlink family has no client. */
+int xeth_sbrx_genl(struct net_device *mux, void *data, size_t n)
+{
+	return xeth_sbrx_msg(mux, NULL, data, n);
+}
+
+// return < 0 if error, 1 if sock closed, and 0 othewise
+int xeth_sbrx(struct net_device *mux, struct xeth_mux_client *client,
+	      struct socket *conn, void *data)
+{
+	struct msghdr oob = {};
+	struct kvec iov = {
+		.iov_base = data,
+		.iov_len = XETH_SIZEOF_JUMBO_FRAME,
+	};
+	int n;
+
+	xeth_mux_inc_sbrx_ticks(mux);
+	n = kernel_recvmsg(conn, &oob, &iov, 1, iov.iov_len, 0);
+	if (n == -EAGAIN) {
+		schedule();
+		return 0;
+	}
+	if (n == 0 || n == -ECONNRESET)
+		return 1;
+	if (n < 0)
+		return n;
+	return xeth_sbrx_msg(mux, client, data, n);
+}
+
+int xeth_sbrx_ring(struct net_device *mux, struct xeth_mux_client *client,
+		   struct xeth_ring *ring, void *data)
+{
+	int n;
+
+	xeth_mux_inc_sbrx_ticks(mux);
+	n = xeth_ring_recv(ring, data, XETH_SIZEOF_JUMBO_FRAME);
+	if (n == -EAGAIN)
+		return xeth_ring_wait_rx(ring);
+	if (n < 0)
+		return n;
+	return xeth_sbrx_msg(mux, client, data, n);
 }
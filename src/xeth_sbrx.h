@@ -10,8 +10,15 @@
 #ifndef __NET_ETHERNET_XETH_SBRX_H
 #define __NET_ETHERNET_XETH_SBRX_H
 
+#include "xeth_mux.h"
 #include <linux/netdevice.h>
 
-int xeth_sbrx(struct net_device *mux, struct socket *conn, void *data);
+struct xeth_ring;
+
+int xeth_sbrx(struct net_device *mux, struct xeth_mux_client *client,
+	      struct socket *conn, void *data);
+int xeth_sbrx_ring(struct net_device *mux, struct xeth_mux_client *client,
+		   struct xeth_ring *ring, void *data);
+int xeth_sbrx_genl(struct net_device *mux, void *data, size_t n);
 
 #endif	/* __NET_ETHERNET_XETH_SBRX_H */
@@ -11,9 +11,17 @@
 #include "xeth_mux.h"
 #include "xeth_proxy.h"
 #include "xeth_lb.h"
+#include "xeth_neigh.h"
+#include "xeth_nh.h"
 #include "xeth_debug.h"
 #include <net/nexthop.h>
 
+bool xeth_sbtx_nexthop_objects = true;
+
+module_param_named(nexthop_objects, xeth_sbtx_nexthop_objects, bool, 0644);
+MODULE_PARM_DESC(nexthop_objects,
+		 " send routes by nexthop id to controllers with the capability");
+
 static void xeth_sbtx_msg_set(void *data, enum xeth_msg_kind kind)
 {
 	struct xeth_msg *msg = data;
@@ -24,13 +32,16 @@ static void xeth_sbtx_msg_set(void *data, enum xeth_msg_kind kind)
 	msg->header.kind = kind;
 }
 
-static inline u64 xeth_sbtx_ns_inum(struct net_device *nd)
+/* Messages that describe the whole state of a device are superseded by the
+ * next of the same kind and xid.
+ */
+static inline void xeth_sbtx_key_xid(struct xeth_sbtxb *sbtxb, u32 xid)
 {
-	struct net *ndnet = dev_net(nd);
-	return net_eq(ndnet, &init_net) ? 1 : ndnet->ns.inum;
+	xeth_sbtxb_set_key(sbtxb, &xid, sizeof(xid));
 }
 
-int xeth_sbtx_break(struct net_device *mux)
+/* @fib: ends a FIB dump rather than an ifinfo dump */
+int xeth_sbtx_break(struct net_device *mux, bool fib)
 {
 	struct xeth_sbtxb *sbtxb;
 	struct xeth_msg_break *msg;
@@ -40,6 +51,7 @@ int xeth_sbtx_break(struct net_device *mux)
 		return -ENOMEM;
 	msg = xeth_sbtxb_data(sbtxb);
 	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_BREAK);
+	sbtxb->bulk = fib;
 	xeth_mux_queue_sbtx(mux, sbtxb);
 	return 0;
 }
@@ -74,6 +86,7 @@ int xeth_sbtx_et_flags(struct net_device *mux, u32 xid, u32 flags)
 	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_ETHTOOL_FLAGS);
 	msg->xid = xid;
 	msg->flags = flags;
+	xeth_sbtx_key_xid(sbtxb, xid);
 	xeth_mux_queue_sbtx(mux, sbtxb);
 	return 0;
 }
@@ -96,6 +109,7 @@ static int xeth_sbtx_et_link_modes(struct net_device *mux,
 	for (bit = 0; bit < bits; bit++)
 		if (test_bit(bit, addr))
 			msg->modes |= 1ULL<<bit;
+	xeth_sbtx_key_xid(sbtxb, xid);
 	xeth_mux_queue_sbtx(mux, sbtxb);
 	return 0;
 }
@@ -127,6 +141,7 @@ int xeth_sbtx_et_settings(struct net_device *mux, u32 xid,
 	msg->mdio_support = ks->base.mdio_support;
 	msg->eth_tp_mdix = ks->base.eth_tp_mdix;
 	msg->eth_tp_mdix_ctrl = ks->base.eth_tp_mdix_ctrl;
+	xeth_sbtx_key_xid(sbtxb, xid);
 	xeth_mux_queue_sbtx(mux, sbtxb);
 	return xeth_sbtx_et_link_modes(mux, kadv, xid,
 				       ks->link_modes.advertising);
@@ -139,6 +154,82 @@ static const char * const xeth_sbtx_fib_event_names[] = {
 	[FIB_EVENT_ENTRY_DEL] "del",
 };
 
+/**
+ * xeth_sbtx_fib_key() - key a route by its prefix, table, tos and priority
+ *
+ * Aliases added, appended or prepended to a prefix share these, as does an
+ * IPv6 multipath sibling, and a FIB dump replays every alias as an ADD, so
+ * only a REPLACE, which always names the first alias of its key, supersedes
+ * an unsent message of the same key. Every other route message is pinned
+ * to keep the order of messages about that key without replacing another
+ * alias's ADD or DEL.
+ */
+static void xeth_sbtx_fib_key(struct xeth_sbtxb *sbtxb, u64 net, u8 family,
+			      const void *address, u8 length, u32 table,
+			      u8 tos, u32 priority, unsigned long event,
+			      bool shared)
+{
+	bool pinned = shared || event != FIB_EVENT_ENTRY_REPLACE;
+	struct {
+		u64 net;
+		u8 address[16];
+		u32 table, priority;
+		u8 family, length, tos, pad;
+	} k;
+
+	memset(&k, 0, sizeof(k));
+	k.net = net;
+	memcpy(k.address, address, family == AF_INET6 ? 16 : 4);
+	k.table = table;
+	k.priority = priority;
+	k.family = family;
+	k.length = length;
+	k.tos = tos;
+	if (pinned)
+		xeth_sbtxb_pin_key(sbtxb, &k, sizeof(k));
+	else
+		xeth_sbtxb_set_key(sbtxb, &k, sizeof(k));
+}
+
+static int xeth_sbtx_fib_nhid_entry(struct net_device *mux,
+				    struct fib_entry_notifier_info *feni,
+				    unsigned long event)
+{
+	struct nexthop *nh = feni->fi->nh;
+	u64 net = xeth_sbtx_net_inum(feni->info.net);
+	struct xeth_sbtxb *sbtxb;
+	struct xeth_msg_fibnhentry *msg;
+	__be32 address = htonl(feni->dst);
+	u64 after;
+
+	after = xeth_nh_export(mux, net, nh);
+	/* a nexthop replace renotifies every route using it; the export of
+	 * the changed object is all that the controller needs
+	 */
+	if (event == FIB_EVENT_ENTRY_REPLACE && feni->fi->nh_updated)
+		return 0;
+	sbtxb = xeth_mux_alloc_sbtxb(mux, sizeof(*msg));
+	if (!sbtxb)
+		return -ENOMEM;
+	msg = xeth_sbtxb_data(sbtxb);
+	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_FIBNHENTRY);
+	msg->net = net;
+	memcpy(msg->address, &address, 4);
+	msg->length = feni->dst_len;
+	msg->event = (u8)event;
+	msg->family = AF_INET;
+	msg->type = feni->type;
+	msg->table = feni->tb_id;
+	msg->nhid = nh->id;
+	msg->tos = feni->tos;
+	xeth_sbtx_fib_key(sbtxb, net, AF_INET, &address, feni->dst_len,
+			  feni->tb_id, feni->tos, feni->fi->fib_priority,
+			  event, false);
+	sbtxb->after = after;
+	xeth_mux_queue_sbtx(mux, sbtxb);
+	return 0;
+}
+
 int xeth_sbtx_fib_entry(struct net_device *mux,
 			struct fib_entry_notifier_info *feni,
 			unsigned long event)
@@ -149,6 +240,8 @@ int xeth_sbtx_fib_entry(struct net_device *mux,
 	struct xeth_msg_fibentry *msg;
 	size_t n = sizeof(*msg);
 
+	if (xeth_sbtx_has_nexthop_objects(mux) && feni->fi->nh)
+		return xeth_sbtx_fib_nhid_entry(mux, feni, event);
 	nhs = fib_info_num_path(feni->fi);
 	if (nhs > 0)
 		n += (nhs * sizeof(struct xeth_next_hop));
@@ -158,8 +251,7 @@ int xeth_sbtx_fib_entry(struct net_device *mux,
 	msg = xeth_sbtxb_data(sbtxb);
 	nh = (typeof(nh))&msg->nh[0];
 	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_FIBENTRY);
-	msg->net = net_eq(feni->info.net, &init_net) ? 1 :
-		feni->info.net->ns.inum;
+	msg->net = xeth_sbtx_net_inum(feni->info.net);
 	msg->address = htonl(feni->dst);
 	msg->mask = inet_make_mask(feni->dst_len);
 	msg->event = (u8)event;
@@ -180,6 +272,44 @@ int xeth_sbtx_fib_entry(struct net_device *mux,
 	no_xeth_debug("%s %pI4/%d w/ %d nexhop(s)",
 		      xeth_sbtx_fib_event_names[event],
 		      &msg->address, feni->dst_len, nhs);
+	xeth_sbtx_fib_key(sbtxb, msg->net, AF_INET, &msg->address,
+			  feni->dst_len, feni->tb_id, feni->tos,
+			  feni->fi->fib_priority,
+			  event, false);
+	xeth_mux_queue_sbtx(mux, sbtxb);
+	return 0;
+}
+
+/* Unlike IPv4, there's no mark of a nexthop replace renotifying the route,
+ * so it's resent, albeit without the nexthops.
+ */
+static int xeth_sbtx_fib6_nhid_entry(struct net_device *mux,
+				     struct fib6_entry_notifier_info *feni,
+				     struct fib6_info *f6i, unsigned long event)
+{
+	u64 net = xeth_sbtx_net_inum(feni->info.net);
+	struct xeth_sbtxb *sbtxb;
+	struct xeth_msg_fibnhentry *msg;
+	u64 after;
+
+	after = xeth_nh_export(mux, net, f6i->nh);
+	sbtxb = xeth_mux_alloc_sbtxb(mux, sizeof(*msg));
+	if (!sbtxb)
+		return -ENOMEM;
+	msg = xeth_sbtxb_data(sbtxb);
+	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_FIBNHENTRY);
+	msg->net = net;
+	memcpy(msg->address, &f6i->fib6_dst.addr, 16);
+	msg->length = f6i->fib6_dst.plen;
+	msg->event = (u8)event;
+	msg->family = AF_INET6;
+	msg->type = f6i->fib6_type;
+	msg->table = f6i->fib6_table->tb6_id;
+	msg->nhid = f6i->nh->id;
+	xeth_sbtx_fib_key(sbtxb, net, AF_INET6, msg->address, msg->length,
+			  msg->table, 0, f6i->fib6_metric,
+			  event, false);
+	sbtxb->after = after;
 	xeth_mux_queue_sbtx(mux, sbtxb);
 	return 0;
 }
@@ -211,8 +341,7 @@ int xeth_sbtx_fib6_nh_entry(struct net_device *mux,
 		return -ENOMEM;
 	msg = xeth_sbtxb_data(sbtxb);
 	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_FIB6ENTRY);
-	msg->net = net_eq(feni->info.net, &init_net) ? 1 :
-		feni->info.net->ns.inum;
+	msg->net = xeth_sbtx_net_inum(feni->info.net);
 	memcpy(msg->address, &f6i->fib6_dst.addr, 16);
 	msg->length = f6i->fib6_dst.plen;
 	msg->event = (u8)event;
@@ -250,6 +379,9 @@ int xeth_sbtx_fib6_nh_entry(struct net_device *mux,
 	xeth_debug("fib6 %s %pI6c/%d w/ %zd nexthop(s)",
 		   xeth_sbtx_fib_event_names[event], msg->address, msg->length,
 		   1 + nsiblings);
+	xeth_sbtx_fib_key(sbtxb, msg->net, AF_INET6, msg->address,
+			  msg->length, msg->table, 0, f6i->fib6_metric,
+			  event, false);
 	xeth_mux_queue_sbtx(mux, sbtxb);
 	return 0;
 }
@@ -268,7 +400,9 @@ int xeth_sbtx_fib6_entry(struct net_device *mux,
 	if (IS_ERR(f6i))
 		return PTR_ERR(f6i);
 	if (f6i->nh)
-		return xeth_sbtx_fib6_nh_entry(mux, feni, f6i, event);
+		return xeth_sbtx_has_nexthop_objects(mux) ?
+			xeth_sbtx_fib6_nhid_entry(mux, feni, f6i, event) :
+			xeth_sbtx_fib6_nh_entry(mux, feni, f6i, event);
 	nsiblings = f6i->fib6_nsiblings;
 	if (nsiblings > 0)
 		sz += nsiblings * sizeof(struct xeth_next_hop6 *);
@@ -277,8 +411,7 @@ int xeth_sbtx_fib6_entry(struct net_device *mux,
 		return -ENOMEM;
 	msg = xeth_sbtxb_data(sbtxb);
 	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_FIB6ENTRY);
-	msg->net = net_eq(feni->info.net, &init_net) ? 1 :
-		feni->info.net->ns.inum;
+	msg->net = xeth_sbtx_net_inum(feni->info.net);
 	memcpy(msg->address, &f6i->fib6_dst.addr, 16);
 	msg->length = f6i->fib6_dst.plen;
 	msg->event = (u8)event;
@@ -311,10 +444,62 @@ int xeth_sbtx_fib6_entry(struct net_device *mux,
 		      xeth_sbtx_fib_event_names[event],
 		      msg->address, msg->length,
 		      nsiblings);
+	xeth_sbtx_fib_key(sbtxb, msg->net, AF_INET6, msg->address,
+			  msg->length, msg->table, 0, f6i->fib6_metric,
+			  event, nsiblings > 0);
 	xeth_mux_queue_sbtx(mux, sbtxb);
 	return 0;
 }
 
+/* The IPv4 notice of a route nexthop that died or revived. */
+int xeth_sbtx_fib_nh(struct net_device *mux, struct fib_nh_notifier_info *fnni,
+		     unsigned long event)
+{
+	if (!xeth_sbtx_has_nexthop_objects(mux))
+		return 0;
+	return xeth_sbtx_nexthop(mux, xeth_sbtx_net_inum(fnni->info.net), 0,
+				 &fnni->fib_nh->nh_common, false, event, NULL);
+}
+
+int xeth_sbtx_fibdump_nhset(struct net_device *mux, u64 net, u32 index,
+			    u8 family, u32 nhid, const void *nh, u16 n,
+			    size_t sz)
+{
+	struct xeth_sbtxb *sbtxb;
+	struct xeth_msg_fibdump_nhset *msg;
+
+	sbtxb = xeth_mux_alloc_sbtxb(mux, sizeof(*msg) + sz);
+	if (!sbtxb)
+		return -ENOMEM;
+	msg = xeth_sbtxb_data(sbtxb);
+	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_FIBDUMP_NHSET);
+	msg->net = net;
+	msg->index = index;
+	msg->nhid = nhid;
+	msg->family = family;
+	msg->n = n;
+	memcpy(msg->nh, nh, sz);
+	xeth_mux_queue_sbtx(mux, sbtxb);
+	return 0;
+}
+
+/* An address add or delete supersedes an unsent one of the same address. */
+static void xeth_sbtx_key_ifa(struct xeth_sbtxb *sbtxb, u32 xid,
+			      const void *address, size_t n, u8 length)
+{
+	struct {
+		u32 xid;
+		u8 address[16];
+		u8 length;
+	} __packed k;
+
+	memset(&k, 0, sizeof(k));
+	k.xid = xid;
+	memcpy(k.address, address, n);
+	k.length = length;
+	xeth_sbtxb_set_key(sbtxb, &k, sizeof(k));
+}
+
 int xeth_sbtx_ifa(struct net_device *mux, struct in_ifaddr *ifa,
 		  unsigned long event, u32 xid)
 {
@@ -330,6 +515,7 @@ int xeth_sbtx_ifa(struct net_device *mux, struct in_ifaddr *ifa,
 	msg->event = event;
 	msg->address = ifa->ifa_address;
 	msg->mask = ifa->ifa_mask;
+	xeth_sbtx_key_ifa(sbtxb, xid, &msg->address, 4, 0);
 	xeth_mux_queue_sbtx(mux, sbtxb);
 	return 0;
 }
@@ -349,6 +535,7 @@ int xeth_sbtx_ifa6(struct net_device *mux, struct inet6_ifaddr *ifa6,
 	msg->event = event;
 	memcpy(msg->address, &ifa6->addr, 16);
 	msg->length = ifa6->prefix_len;
+	xeth_sbtx_key_ifa(sbtxb, xid, msg->address, 16, msg->length);
 	xeth_mux_queue_sbtx(mux, sbtxb);
 	return 0;
 }
@@ -367,7 +554,7 @@ int xeth_sbtx_ifinfo(struct xeth_proxy *proxy, unsigned iff,
 	msg = xeth_sbtxb_data(sbtxb);
 	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_IFINFO);
 	strlcpy(msg->ifname, proxy->nd->name, IFNAMSIZ);
-	msg->net = xeth_sbtx_ns_inum(proxy->nd);
+	msg->net = xeth_sbtx_net_inum(dev_net(proxy->nd));
 	msg->ifindex = proxy->nd->ifindex;
 	msg->xid = proxy->xid;
 	switch (proxy->kind) {
@@ -389,41 +576,49 @@ int xeth_sbtx_ifinfo(struct xeth_proxy *proxy, unsigned iff,
 	msg->kind = proxy->kind;
 	msg->reason = reason;
 	msg->features = proxy->nd->features;
+	switch (reason) {
+	case XETH_IFINFO_REASON_NEW:
+	case XETH_IFINFO_REASON_DEL:
+	case XETH_IFINFO_REASON_REG:
+	case XETH_IFINFO_REASON_UNREG:
+		/* nothing may be superseded ahead of a device's lifecycle */
+		sbtxb->barrier = true;
+		break;
+	default:
+		xeth_sbtx_key_xid(sbtxb, proxy->xid);
+	}
 	xeth_mux_queue_sbtx(proxy->mux, sbtxb);
 	return 0;
 }
 
+/* The message is built on the stack to be compared with the last sent
+ * before allocating anything.
+ */
 int xeth_sbtx_neigh_update(struct net_device *mux, struct neighbour *neigh)
 {
-	struct xeth_sbtxb *sbtxb;
-	struct xeth_msg_neigh_update *msg;
+	struct xeth_msg_neigh_update msg;
 
-	sbtxb = xeth_mux_alloc_sbtxb(mux, sizeof(*msg));
-	if (!sbtxb)
-		return -ENOMEM;
-	msg = xeth_sbtxb_data(sbtxb);
-	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_NEIGH_UPDATE);
-	msg->ifindex = neigh->dev->ifindex;
-	msg->net = xeth_sbtx_ns_inum(neigh->dev);
-	msg->ifindex = neigh->dev->ifindex;
-	msg->family = neigh->ops->family;
-	msg->len = neigh->tbl->key_len;
-	memcpy(msg->dst, neigh->primary_key, neigh->tbl->key_len);
+	memset(&msg, 0, sizeof(msg));
+	xeth_sbtx_msg_set(&msg, XETH_MSG_KIND_NEIGH_UPDATE);
+	msg.net = xeth_sbtx_net_inum(dev_net(neigh->dev));
+	msg.ifindex = neigh->dev->ifindex;
+	msg.family = neigh->ops->family;
+	msg.len = neigh->tbl->key_len;
+	memcpy(msg.dst, neigh->primary_key, neigh->tbl->key_len);
 	read_lock_bh(&neigh->lock);
 	if ((neigh->nud_state & NUD_VALID) && !neigh->dead) {
 		char ha[MAX_ADDR_LEN];
 		neigh_ha_snapshot(ha, neigh, neigh->dev);
 		if ((neigh->nud_state & NUD_VALID) && !neigh->dead)
-			memcpy(&msg->lladdr[0], ha, ETH_ALEN);
+			memcpy(&msg.lladdr[0], ha, ETH_ALEN);
 	}
 	read_unlock_bh(&neigh->lock);
-	xeth_mux_queue_sbtx(mux, sbtxb);
-	return 0;
+	return xeth_neigh_send(mux, &msg);
 }
 
 int xeth_sbtx_netns(struct net_device *mux, struct net *ndnet, bool add)
 {
-	uint64_t net = net_eq(ndnet, &init_net) ? 1 : ndnet->ns.inum;
+	uint64_t net = xeth_sbtx_net_inum(ndnet);
 	struct xeth_sbtxb *sbtxb;
 	struct xeth_msg_netns *msg;
 
@@ -434,6 +629,119 @@ int xeth_sbtx_netns(struct net_device *mux, struct net *ndnet, bool add)
 	xeth_sbtx_msg_set(msg, add ?
 			  XETH_MSG_KIND_NETNS_ADD : XETH_MSG_KIND_NETNS_DEL);
 	msg->net = net;
+	sbtxb->barrier = true;
+	xeth_mux_queue_sbtx(mux, sbtxb);
+	return 0;
+}
+
+/* If given, @seq is set to the message sequence number. The dead or revived
+ * notices of an anonymous (@id 0) nexthop supersede one another.
+ */
+int xeth_sbtx_nexthop(struct net_device *mux, u64 net, u32 id,
+		      struct fib_nh_common *nhc, bool reject,
+		      unsigned long event, u64 *seq)
+{
+	struct xeth_sbtxb *sbtxb;
+	struct xeth_msg_nexthop *msg;
+	u64 n;
+
+	sbtxb = xeth_mux_alloc_sbtxb(mux, sizeof(*msg));
+	if (!sbtxb)
+		return -ENOMEM;
+	msg = xeth_sbtxb_data(sbtxb);
+	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_NEXTHOP);
+	msg->net = net;
+	msg->id = id;
+	msg->ifindex = nhc->nhc_dev ? nhc->nhc_dev->ifindex : 0;
+	msg->flags = nhc->nhc_flags;
+	msg->family = nhc->nhc_family;
+	msg->event = (u8)event;
+	msg->scope = nhc->nhc_scope;
+	msg->reject = reject ? 1 : 0;
+	if (nhc->nhc_gw_family == AF_INET)
+		memcpy(msg->gw, &nhc->nhc_gw.ipv4, 4);
+	else if (nhc->nhc_gw_family == AF_INET6)
+		memcpy(msg->gw, &nhc->nhc_gw.ipv6, 16);
+	if (!id) {
+		struct {
+			u64 net;
+			s32 ifindex;
+			u8 gw[16];
+		} __packed k;
+
+		k.net = net;
+		k.ifindex = msg->ifindex;
+		memcpy(k.gw, msg->gw, 16);
+		xeth_sbtxb_set_key(sbtxb, &k, sizeof(k));
+	}
+	n = xeth_mux_queue_sbtx(mux, sbtxb);
+	if (seq)
+		*seq = n;
+	return 0;
+}
+
+int xeth_sbtx_nexthop_group(struct net_device *mux, u64 net, u32 id,
+			    struct nh_group *nhg, u64 *seq)
+{
+	struct xeth_sbtxb *sbtxb;
+	struct xeth_msg_nexthop_group *msg;
+	u64 n;
+	int i;
+
+	sbtxb = xeth_mux_alloc_sbtxb(mux, sizeof(*msg) +
+				     (nhg->num_nh * sizeof(msg->nh[0])));
+	if (!sbtxb)
+		return -ENOMEM;
+	msg = xeth_sbtxb_data(sbtxb);
+	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_NEXTHOP_GROUP);
+	msg->net = net;
+	msg->id = id;
+	msg->n = nhg->num_nh;
+	msg->mpath = nhg->mpath ? 1 : 0;
+	for (i = 0; i < nhg->num_nh; i++) {
+		msg->nh[i].id = nhg->nh_entries[i].nh->id;
+		msg->nh[i].weight = nhg->nh_entries[i].weight;
+	}
+	n = xeth_mux_queue_sbtx(mux, sbtxb);
+	if (seq)
+		*seq = n;
+	return 0;
+}
+
+/* @flags, if given, are the xeth_qsfp_n_flags of an INTERRUPT event. */
+int xeth_sbtx_qsfp(struct net_device *mux, u32 xid, u32 event, const u8 *flags)
+{
+	struct xeth_sbtxb *sbtxb;
+	struct xeth_msg_qsfp *msg;
+
+	sbtxb = xeth_mux_alloc_sbtxb(mux, sizeof(*msg));
+	if (!sbtxb)
+		return -ENOMEM;
+	msg = xeth_sbtxb_data(sbtxb);
+	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_QSFP);
+	msg->xid = xid;
+	msg->event = event;
+	if (flags)
+		memcpy(msg->flags, flags, sizeof(msg->flags));
+	else
+		memset(msg->flags, 0, sizeof(msg->flags));
+	memset(msg->pad, 0, sizeof(msg->pad));
+	xeth_mux_queue_sbtx(mux, sbtxb);
+	return 0;
+}
+
+int xeth_sbtx_stats_request(struct net_device *mux, u32 xid, u32 stats)
+{
+	struct xeth_sbtxb *sbtxb;
+	struct xeth_msg_stats_request *msg;
+
+	sbtxb = xeth_mux_alloc_sbtxb(mux, sizeof(*msg));
+	if (!sbtxb)
+		return -ENOMEM;
+	msg = xeth_sbtxb_data(sbtxb);
+	xeth_sbtx_msg_set(msg, XETH_MSG_KIND_STATS_REQUEST);
+	msg->xid = xid;
+	msg->stats = stats;
 	xeth_mux_queue_sbtx(mux, sbtxb);
 	return 0;
 }
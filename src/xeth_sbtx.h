@@ -10,6 +10,7 @@
 #ifndef __NET_ETHERNET_XETH_SBTX_H
 #define __NET_ETHERNET_XETH_SBTX_H
 
+#include "xeth_mux.h"
 #include "xeth_proxy.h"
 #include <linux/netdevice.h>
 #include <linux/inetdevice.h>
@@ -18,9 +19,46 @@
 #include <net/ip6_fib.h>
 #include <net/netevent.h>
 
+struct nh_group;
+
+enum {
+	xeth_sbtxb_max_key = 40,
+};
+
+/* Who takes a message; a dump is addressed to its requester alone. */
+enum xeth_sbtxb_to {
+	xeth_sbtxb_to_all,
+	xeth_sbtxb_to_client,
+	xeth_sbtxb_to_genl,
+};
+
 struct xeth_sbtxb {
 	struct list_head list;
+	/* @node: in the mux index of keyed messages */
+	struct hlist_node node;
 	size_t len, sz;
+	/* @seq: side-band sequence number */
+	u64 seq;
+	/* @after: don't supersede a message numbered at or before this */
+	u64 after;
+	/* @gen: barrier generation when logged */
+	u32 gen;
+	/* @key: identifies the message object, if @keylen */
+	u8 key[xeth_sbtxb_max_key];
+	u8 keylen;
+	/* @pinned: keyed to order later messages, but never replaced */
+	bool pinned;
+	/* @barrier: no later message may supersede one logged before this */
+	bool barrier;
+	/* @sent: copied by a client, so no longer replaceable */
+	bool sent;
+	/* @bulk: a BREAK that ends a FIB dump, so follows its routes */
+	bool bulk;
+	/* @to: enum xeth_sbtxb_to, set on allocation by the dumping task;
+	 * @client: the id of the requester if xeth_sbtxb_to_client
+	 */
+	u8 to;
+	unsigned int client;
 };
 
 enum {
@@ -37,10 +75,50 @@ static inline void xeth_sbtxb_zero(const struct xeth_sbtxb *sbtxb)
 	memset(xeth_sbtxb_data(sbtxb), 0, sbtxb->len);
 }
 
+/* The side-band identifies a netns by its inode number, init_net by 1. */
+static inline u64 xeth_sbtx_net_inum(struct net *net)
+{
+	return net_eq(net, &init_net) ? 1 : net->ns.inum;
+}
+
+extern bool xeth_sbtx_nexthop_objects;
+
+/* Nexthop objects are sent if allowed and all synced controllers agree. */
+static inline bool xeth_sbtx_has_nexthop_objects(struct net_device *mux)
+{
+	return xeth_sbtx_nexthop_objects &&
+		(xeth_mux_caps(mux) & XETH_CAP_NEXTHOP_OBJECTS);
+}
+
+/* Let a later message of the same kind and key supersede this one. */
+static inline void xeth_sbtxb_set_key(struct xeth_sbtxb *sbtxb,
+				      const void *key, size_t len)
+{
+	if (WARN_ON(len > xeth_sbtxb_max_key))
+		return;
+	memcpy(sbtxb->key, key, len);
+	sbtxb->keylen = len;
+}
+
+/* Order later messages of the key after this one, which stays in place. */
+static inline void xeth_sbtxb_pin_key(struct xeth_sbtxb *sbtxb,
+				      const void *key, size_t len)
+{
+	xeth_sbtxb_set_key(sbtxb, key, len);
+	sbtxb->pinned = true;
+}
+
 struct xeth_sbtxb *xeth_mux_alloc_sbtxb(struct net_device *mux, size_t);
-void xeth_mux_queue_sbtx(struct net_device *mux, struct xeth_sbtxb *);
+u64 xeth_mux_queue_sbtx(struct net_device *mux, struct xeth_sbtxb *);
+u64 xeth_mux_client_caps(struct xeth_mux_client *);
+void xeth_mux_hello(struct xeth_mux_client *, u64 kinds, u64 caps);
+int xeth_mux_set_fib_filter(struct xeth_mux_client *,
+			    const struct xeth_fib_filter_entry *, size_t n);
+void xeth_mux_resync(struct xeth_mux_client *, u64 seq, u64 epoch);
+void xeth_mux_subscribe(struct xeth_mux_client *, u64 kinds);
+void xeth_mux_sync(struct xeth_mux_client *);
 
-int xeth_sbtx_break(struct net_device *);
+int xeth_sbtx_break(struct net_device *, bool fib);
 int xeth_sbtx_change_upper(struct net_device *, u32 upper_xid, u32 lower_xid,
 			   bool linking);
 int xeth_sbtx_et_flags(struct net_device *, u32 xid, u32 flags);
@@ -52,6 +130,11 @@ int xeth_sbtx_fib_entry(struct net_device *,
 int xeth_sbtx_fib6_entry(struct net_device *,
 			 struct fib6_entry_notifier_info *feni,
 			 unsigned long event);
+int xeth_sbtx_fib_nh(struct net_device *, struct fib_nh_notifier_info *fnni,
+		     unsigned long event);
+int xeth_sbtx_fibdump_nhset(struct net_device *, u64 net, u32 index,
+			    u8 family, u32 nhid, const void *nh, u16 n,
+			    size_t sz);
 int xeth_sbtx_ifa(struct net_device *, struct in_ifaddr *ifa,
 		  unsigned long event, u32 xid);
 int xeth_sbtx_ifa6(struct net_device *, struct inet6_ifaddr *ifa,
@@ -60,5 +143,12 @@ int xeth_sbtx_ifinfo(struct xeth_proxy *, unsigned iff,
 		     enum xeth_msg_ifinfo_reason);
 int xeth_sbtx_neigh_update(struct net_device *, struct neighbour *neigh);
 int xeth_sbtx_netns(struct net_device *, struct net *ndnet, bool add);
+int xeth_sbtx_nexthop(struct net_device *, u64 net, u32 id,
+		      struct fib_nh_common *, bool reject, unsigned long event,
+		      u64 *seq);
+int xeth_sbtx_nexthop_group(struct net_device *, u64 net, u32 id,
+			    struct nh_group *, u64 *seq);
+int xeth_sbtx_qsfp(struct net_device *, u32 xid, u32 event, const u8 *flags);
+int xeth_sbtx_stats_request(struct net_device *, u32 xid, u32 stats);
 
 #endif	/* __NET_ETHERNET_XETH_SBTX_H */